@@ -2,23 +2,23 @@
 #define CIRCULAR_BUFFER_H
 
 #include <semaphore.h>
+#include "ipc.h"
+#include "trace.h"
 
 #define BUF_LEN 8
-#define SHARED_MEM_NAME "/shared_circ_buff"
-#define SEMAPHORE_FREE_NAME "/free_slots"
-#define SEMAPHORE_USED_NAME "/used_slots"
-
-#ifdef DEBUG
-	#define debug(fmt, ...) \
-		(void) fprintf(stderr, "[%s:%d] " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
-#else
-	#define debug(msg, ...) 
-#endif
+#define IPC_NAMESPACE "circbuff" // /circbuff.shm, /circbuff.free and /circbuff.used
+#define CACHE_LINE 64
 
+/* The writer's and the reader's indices each sit on a cache line of their own, so
+   updating one doesn't invalidate the line the other side is working on. The free and
+   used semaphores count the slots, neither side reads the index of the other per value.
+   The layout is also the ring file of a journal, files of older builds don't fit it */
 typedef struct {
-	int buf[BUF_LEN];
-	int wr_pos;
-	int rd_pos;
+	_Alignas(CACHE_LINE) int wr_pos;
+	unsigned long wr_seq; // values ever written, journal offset of the next record
+	_Alignas(CACHE_LINE) int rd_pos;
+	unsigned long rd_seq; // values ever read, the offset a reader saves
+	_Alignas(CACHE_LINE) int buf[BUF_LEN];
 } SharedBuffer;
 
 #endif
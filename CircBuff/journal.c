@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "journal.h"
+
+/* Maps a whole file of the given size, creating/extending an empty one if allowed.
+   A file of any other size was written with another layout and is rejected */
+static void *map_file(const char *path, size_t size, bool writable, bool create, bool *created) {
+	int flags = writable ? O_RDWR : O_RDONLY;
+	if (create) flags |= O_CREAT;
+
+	int fd = open(path, flags, 0666);
+	if (fd == -1) {
+		debug("Couldn't open %s. Error: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return NULL;
+	}
+	if (created != NULL) *created = (st.st_size == 0);
+	if (st.st_size != 0 && (size_t) st.st_size != size) {
+		debug("File %s has %lld bytes instead of %zu, it doesn't fit this build", path,
+			(long long) st.st_size, size);
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((size_t) st.st_size < size) {
+		if (!writable || ftruncate(fd, size) == -1) {
+			debug("File %s is too small and can't be extended", path);
+			if (!writable) errno = EINVAL;
+			close(fd);
+			return NULL;
+		}
+	}
+
+	void *addr = mmap(0, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if (addr == MAP_FAILED) return NULL;
+	return addr;
+}
+
+SharedBuffer *journal_map_ring(const char *dir, bool create, bool *created) {
+	char path[JOURNAL_PATH_LEN];
+	snprintf(path, sizeof(path), "%s/%s", dir, JOURNAL_RING_FILE);
+	debug("Mapping ring file %s", path);
+	return map_file(path, sizeof(SharedBuffer), true, create, created);
+}
+
+int journal_unmap_ring(SharedBuffer *ring) {
+	if (msync(ring, sizeof(SharedBuffer), MS_SYNC) == -1) return -1;
+	return munmap(ring, sizeof(SharedBuffer));
+}
+
+void journal_init(Journal *journal, const char *dir, bool writable) {
+	journal->dir = dir;
+	journal->writable = writable;
+	journal->index = -1;
+	journal->segment = NULL;
+	journal->pending = 0;
+}
+
+static int unmap_segment(Journal *journal) {
+	if (journal->segment == NULL) return 0;
+	int res = 0;
+	if (journal->writable && msync(journal->segment, sizeof(JournalSegment), MS_SYNC) == -1)
+		res = -1;
+	if (munmap(journal->segment, sizeof(JournalSegment)) == -1)
+		res = -1;
+	journal->segment = NULL;
+	journal->index = -1;
+	return res;
+}
+
+/* Makes segment number index the mapped one, rolling over from the current */
+static int map_segment(Journal *journal, long index) {
+	if (journal->index == index) return 0;
+	if (unmap_segment(journal) == -1) return -1;
+
+	char path[JOURNAL_PATH_LEN];
+	snprintf(path, sizeof(path), "%s/segment.%06ld", journal->dir, index);
+	debug("Mapping journal segment %s", path);
+
+	bool created = false;
+	JournalSegment *segment = map_file(path, sizeof(JournalSegment), journal->writable,
+		journal->writable, &created);
+	if (segment == NULL) return -1;
+
+	if (created) {
+		segment->magic = JOURNAL_MAGIC;
+		segment->index = index;
+		segment->count = 0;
+	} else if (segment->magic != JOURNAL_MAGIC || segment->index != index) {
+		debug("Segment %s is corrupt. Magic: %x, index: %u", path, segment->magic, segment->index);
+		munmap(segment, sizeof(JournalSegment));
+		errno = EINVAL;
+		return -1;
+	}
+
+	journal->segment = segment;
+	journal->index = index;
+	return 0;
+}
+
+/* Rolling over to a new segment syncs the old one while unmapping it, the
+   batch itself is synced by the caller once journal_sync_due() says so */
+int journal_append(Journal *journal, unsigned long seq, int val) {
+	if (map_segment(journal, seq / JOURNAL_SEGMENT_ENTRIES) == -1) return -1;
+
+	unsigned long slot = seq % JOURNAL_SEGMENT_ENTRIES;
+	journal->segment->values[slot] = val;
+	journal->segment->count = slot + 1;
+	journal->pending++;
+	return 0;
+}
+
+bool journal_sync_due(const Journal *journal) {
+	return journal->pending >= JOURNAL_SYNC_BATCH;
+}
+
+int journal_read(Journal *journal, unsigned long seq, int *val) {
+	if (map_segment(journal, seq / JOURNAL_SEGMENT_ENTRIES) == -1) return -1;
+
+	unsigned long slot = seq % JOURNAL_SEGMENT_ENTRIES;
+	if (slot >= journal->segment->count) {
+		debug("Offset %lu was never written to the journal", seq);
+		errno = ERANGE;
+		return -1;
+	}
+	*val = journal->segment->values[slot];
+	return 0;
+}
+
+/* Flushes the records of the current batch and then the ring, so a durable
+   wr_seq never points past durable journal records */
+int journal_sync(Journal *journal, SharedBuffer *ring) {
+	if (journal->pending == 0) return 0;
+	debug("Syncing %lu journal records", journal->pending);
+	if (journal->segment != NULL && msync(journal->segment, sizeof(JournalSegment), MS_SYNC) == -1)
+		return -1;
+	if (ring != NULL && msync(ring, sizeof(SharedBuffer), MS_SYNC) == -1)
+		return -1;
+	journal->pending = 0;
+	return 0;
+}
+
+int journal_close(Journal *journal, SharedBuffer *ring) {
+	int res = 0;
+	if (journal->writable && journal_sync(journal, ring) == -1) res = -1;
+	if (unmap_segment(journal) == -1) res = -1;
+	return res;
+}
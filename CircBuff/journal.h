@@ -0,0 +1,40 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include "circular_buffer.h"
+
+#define JOURNAL_MAGIC 0x4a524e4c /* "JRNL" */
+#define JOURNAL_SEGMENT_ENTRIES 4096
+#define JOURNAL_SYNC_BATCH 8
+#define JOURNAL_RING_FILE "ring"
+#define JOURNAL_PATH_LEN 256
+
+/* One append-only segment file. Segment n holds the values with journal
+   offsets [n * JOURNAL_SEGMENT_ENTRIES, (n+1) * JOURNAL_SEGMENT_ENTRIES) */
+typedef struct {
+	unsigned int magic;
+	unsigned int index;
+	unsigned long count;
+	int values[JOURNAL_SEGMENT_ENTRIES];
+} JournalSegment;
+
+typedef struct {
+	const char *dir;
+	bool writable;
+	long index;               /* index of the mapped segment, -1 if none */
+	JournalSegment *segment;
+	unsigned long pending;    /* records appended since the last msync */
+} Journal;
+
+SharedBuffer *journal_map_ring(const char *dir, bool create, bool *created);
+int journal_unmap_ring(SharedBuffer *ring);
+
+void journal_init(Journal *journal, const char *dir, bool writable);
+int journal_append(Journal *journal, unsigned long seq, int val);
+bool journal_sync_due(const Journal *journal);
+int journal_read(Journal *journal, unsigned long seq, int *val);
+int journal_sync(Journal *journal, SharedBuffer *ring);
+int journal_close(Journal *journal, SharedBuffer *ring);
+
+#endif
@@ -1,25 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 #include <semaphore.h>
 #include <unistd.h>
 #include "circular_buffer.h"
+#include "journal.h"
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
 
 
 // Global vars for free_resources
-int shm_fd;
+IpcSegment segment; // stays closed if the ring is a journal file
+IpcSemaphore free_slots, used_slots;
 SharedBuffer *shared_buffer;
 sem_t *res_free, *used;
+char *journal_dir = NULL; // NULL unless the ring is backed by a journal directory (-j)
 
 void error_hanlde(void);
 int read_value(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used);
 void free_resources(void);
-void print_semaphore_value(sem_t *sem);
+void trace_semaphores(const char *name, sem_t *res_free, sem_t *used);
+void replay_journal(unsigned long offset);
 
+void usage(void) {
+	fprintf(stderr, "Usage: reader [-j journal_dir [-r offset]] [-N node]\n");
+	exit(EXIT_FAILURE);
+}
 
 void error_handle(void) {
 	fprintf(stdout, "An error occured: %s\n", strerror(errno));
@@ -27,12 +33,12 @@ void error_handle(void) {
 	exit(EXIT_FAILURE);
 }
 
-void print_semaphore_value(sem_t *sem) {
-	int sval;
-	if (sem_getvalue(sem, &sval) == -1)
-		debug("Couldn't get sempahore value. Error: %s", strerror(errno));
-	else
-		printf("Semaphore value: %d\n", sval);
+// Records both semaphore values, they only cost system calls while debug events are recorded
+void trace_semaphores(const char *name, sem_t *res_free, sem_t *used) {
+	int free_val, used_val;
+	if (!trace_enabled(TRACE_DEBUG)) return;
+	if (sem_getvalue(res_free, &free_val) == -1 || sem_getvalue(used, &used_val) == -1) return;
+	trace_record(TRACE_DEBUG, 'i', name, free_val, used_val);
 }
 
 int read_value(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used) {
@@ -42,8 +48,10 @@ int read_value(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used) {
 	}
 
 	debug("Waiting used semaphore");
-	print_semaphore_value(used);
+	trace_semaphores("semaphores before read", res_free, used);
+	TRACE_BEGIN(TRACE_INFO, "wait used slot");
 	if (sem_wait(used) == -1) error_handle();
+	TRACE_END(TRACE_INFO, "wait used slot");
 	/* The reader process will wait on the used semaphore before reading.
 	   If used is 0, it means there is no data availabe to read, so the
 	   reader will block until there is data */
@@ -51,49 +59,101 @@ int read_value(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used) {
     debug("### ENTERED CRITICAL SECTION ###");
 	int val = shared_buffer->buf[shared_buffer->rd_pos];
 	shared_buffer->rd_pos = (shared_buffer->rd_pos + 1) % BUF_LEN;
+	shared_buffer->rd_seq++;
 	debug("Posting free semaphore");
-	print_semaphore_value(res_free);
 	if (sem_post(res_free) == -1) error_handle();
 	debug("### LEFT CRITICAL SECTION ###");
-	debug("Free semaphore after posting:"); print_semaphore_value(res_free);
+	TRACE(TRACE_INFO, "read", shared_buffer->rd_seq - 1, val);
+	trace_semaphores("semaphores after read", res_free, used);
 	return val;
 }
 
+/* Prints the journal records [offset, wr_seq) without consuming anything from the ring */
+void replay_journal(unsigned long offset) {
+	Journal replay;
+	journal_init(&replay, journal_dir, false);
+
+	unsigned long end = shared_buffer->wr_seq;
+	debug("Replaying journal from offset %lu up to %lu", offset, end);
+	for (unsigned long seq = offset; seq < end; seq++) {
+		int val;
+		if (journal_read(&replay, seq, &val) == -1) error_handle();
+		printf("Reader: Replayed %d from offset %lu\n", val, seq);
+	}
+
+	if (journal_close(&replay, NULL) == -1)
+		debug("Failed to close journal. Error: %s", strerror(errno));
+}
+
 void free_resources(void) {
 	debug("Starting to free resources...");
-	if (munmap(shared_buffer, sizeof(SharedBuffer)) == -1)
+	if (journal_dir != NULL) {
+		printf("Reader: saved offset %lu\n", shared_buffer->rd_seq);
+		if (journal_unmap_ring(shared_buffer) == -1)
+			debug("Failed to sync and unmap ring file. Error: %s", strerror(errno));
+	} else if (ipc_segment_close(&segment) == -1) {
 		debug("Failed to unmap shared buffer. Error: %s", strerror(errno));
-	if (close(shm_fd) == -1)
-		debug("Failed to close shared memory file descriptor. Error: %s", strerror(errno));
-	if (sem_close(res_free) == -1)
+	}
+	if (ipc_sem_close(&free_slots) == -1)
 		debug("Failed to close free semaphore. Error: %s", strerror(errno));
-	if (sem_close(used) == -1)
+	if (ipc_sem_close(&used_slots) == -1)
 		debug("Failed to close used semaphore. Error: %s", strerror(errno));
 	exit(0);
 }
 
-int main(void) {
-	debug("Opening SHARED_MEM_NAME %s\n", SHARED_MEM_NAME);
-	int shm_fd = shm_open(SHARED_MEM_NAME, O_RDWR, 0666);
-	if (shm_fd == -1) error_handle();
-
-	debug("Mapping shared memory", NULL);
-	SharedBuffer *shared_buffer = mmap(0, sizeof(SharedBuffer), PROT_READ | PROT_WRITE, \
-    	 MAP_SHARED, shm_fd, 0);
-	if (shared_buffer == MAP_FAILED) error_handle();
+int main(int argc, char **argv) {
+	bool replay = false;
+	unsigned long replay_offset = 0;
+	int node = -1; // NUMA node to run on, the writer binds the ring to it
+	char *end;
+
+	int c;
+	while ((c = getopt(argc, argv, "j:r:N:")) != -1) {
+		switch (c) {
+			case 'j': journal_dir = optarg;
+				break;
+			case 'r':
+				replay = true;
+				errno = 0;
+				replay_offset = strtoul(optarg, &end, 10);
+				if (errno != 0 || *optarg == '\0' || *end != '\0') usage();
+				break;
+			case 'N':
+				node = strtol(optarg, &end, 10);
+				if (*optarg == '\0' || *end != '\0' || node < 0) usage();
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+	if (replay && journal_dir == NULL) usage();
+	if (node != -1 && ipc_pin_to_node(node) == -1) error_handle();
+
+	if (journal_dir == NULL) {
+		debug("Opening shared memory in namespace %s", IPC_NAMESPACE);
+		if (ipc_segment_open(&segment, IPC_NAMESPACE, "shm", sizeof(SharedBuffer), \
+				IPC_PREFAULT | IPC_LOCK) == -1)
+			error_handle();
+		shared_buffer = segment.addr;
+	} else {
+		debug("Journal mode, mapping ring file in %s", journal_dir);
+		shared_buffer = journal_map_ring(journal_dir, false, NULL);
+		if (shared_buffer == NULL) error_handle();
+		if (replay) replay_journal(replay_offset);
+	}
 
 	debug("Opening semaphores");
-	sem_t *res_free = sem_open(SEMAPHORE_FREE_NAME, 0);
-	sem_t *used = sem_open(SEMAPHORE_USED_NAME, 0);
-
-	debug("Created sempahores data:");
-	printf("\tRes_free semaphore: "); print_semaphore_value(res_free);
-	printf("\tUsed semaphore: "); print_semaphore_value(used);
-
-	if (res_free == SEM_FAILED || used == SEM_FAILED) {
-		debug("res_free: %d, used: %d", res_free, used);
+	if (ipc_sem_open(&free_slots, IPC_NAMESPACE, "free") == -1
+			|| ipc_sem_open(&used_slots, IPC_NAMESPACE, "used") == -1) {
+		debug("Failed to open %s or %s", free_slots.name, used_slots.name);
+		// Replaying a journal doesn't need a live writer
+		if (replay && errno == ENOENT) free_resources();
 		error_handle();
 	}
+	res_free = free_slots.sem;
+	used = used_slots.sem;
+
+	trace_semaphores("semaphores opened", res_free, used);
 
 	void handle_signal(int signal) {
 		debug("SIGINT received. Freeing resources");
@@ -1,24 +1,17 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <semaphore.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 #include "circular_buffer.h"
+#include "journal.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
 
-#ifdef DEBUG
-#define debug(fmt, ...) \
-	(void) fprintf(stderr, "[%s:%d] " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
-#else
-#define debug(msg, ...)
-#endif
-
-int shm_fd;
-SharedBuffer *shared_buffer;
-sem_t *res_free, *used;
+IpcSegment segment; // stays closed if the ring is a journal file
+IpcSemaphore free_slots, used_slots;
+char *journal_dir = NULL; // NULL unless the ring is backed by a journal directory (-j)
+Journal journal;
 
 void error_handle(void) {
 	debug("Launched error handling");
@@ -26,85 +19,137 @@ void error_handle(void) {
 	exit(EXIT_FAILURE);
 }
 
-void print_semaphore_value(sem_t *sem) {
-	int sval;
-    if (sem_getvalue(sem, &sval) == -1)
-    	debug("Couldn't get sempahore value. Error: %s", strerror(errno));
-	else
-		printf("Semaphore value: %d\n", sval);
+void usage(void) {
+	fprintf(stderr, "Usage: writer [-j journal_dir] [-N node]\n");
+	exit(EXIT_FAILURE);
+}
+
+/* A writer killed before free_resources leaves its semaphores behind. The ring file
+   says how many values are unread, so stale semaphores are replaced, not reused */
+void unlink_stale_semaphore(const char *object) {
+	char name[IPC_NAME_LEN];
+	if (ipc_name(name, IPC_NAMESPACE, object) == -1) error_handle();
+	if (sem_unlink(name) == 0) debug("Unlinked stale semaphore %s", name);
+	else if (errno != ENOENT) error_handle();
+}
+
+// Records both semaphore values, they only cost system calls while debug events are recorded
+void trace_semaphores(const char *name, sem_t *res_free, sem_t *used) {
+	int free_val, used_val;
+	if (!trace_enabled(TRACE_DEBUG)) return;
+	if (sem_getvalue(res_free, &free_val) == -1 || sem_getvalue(used, &used_val) == -1) return;
+	trace_record(TRACE_DEBUG, 'i', name, free_val, used_val);
 }
 
 void write_value(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used, int val) {
 	debug("Waiting res_free.");
-	printf("res_free semaphore: "); print_semaphore_value(res_free);
-	printf("used semaphore: "); print_semaphore_value(used);
+	trace_semaphores("semaphores before write", res_free, used);
+	TRACE_BEGIN(TRACE_INFO, "wait free slot");
 	if (sem_wait(res_free) == -1) error_handle();
+	TRACE_END(TRACE_INFO, "wait free slot");
 	/* If res_free reaches 0, it means the buffer is full, and any additional
 	   attempt by the writer to sem_wait(res_free) will block until a reader
 	   res_frees up a slot by reading a value and calling sem_post(res_free) */
 
 	debug("### ENTERED CRITICAL SECTION ###");
     debug("Writing value to position %d", shared_buffer->wr_pos);
+	if (journal_dir != NULL && journal_append(&journal, shared_buffer->wr_seq, val) == -1)
+		error_handle();
 	shared_buffer->buf[shared_buffer->wr_pos] = val;
 	shared_buffer->wr_pos = (shared_buffer->wr_pos + 1) % BUF_LEN;
+	shared_buffer->wr_seq++;
+	/* The durability cost is paid once per batch, values of an unfinished
+	   batch are only as durable as the kernel's own writeback makes them */
+	if (journal_dir != NULL && journal_sync_due(&journal)) {
+		if (journal_sync(&journal, shared_buffer) == -1) error_handle();
+	}
 	debug("Incremented position to %d and posting used", shared_buffer->wr_pos);
 	if (sem_post(used) == -1) error_handle();
 
 	debug("### CRITICAL SECTION LEFT ###");
-	printf("res_free semaphore: "); print_semaphore_value(res_free);
-	printf("used semaphore: "); print_semaphore_value(used);
+	TRACE(TRACE_INFO, "write", shared_buffer->wr_seq - 1, val);
+	trace_semaphores("semaphores after write", res_free, used);
 }
 
-void free_resources(SharedBuffer *shared_buffer, sem_t *res_free, sem_t *used) {
+void free_resources(SharedBuffer *shared_buffer) {
 	printf("Freeing resources\n");
-	close(shm_fd);
-
-	debug("Unmapping shread_buffer");
-	if (munmap(shared_buffer, sizeof(SharedBuffer)) == -1) error_handle();
-
-	debug("Closing res_free semaphore");
- 	if (sem_close(res_free) == -1) error_handle();
 
- 	debug("Closing used semaphore");
-	if (sem_close(used) == -1) error_handle();
-
-	debug("Unlinking shared memory");
-	if (shm_unlink(SHARED_MEM_NAME) == -1) error_handle();
-
-	debug("Unlinking free semaphore");
-	if (sem_unlink(SEMAPHORE_FREE_NAME) == -1) error_handle();
+	// The ring file of a journal outlives the writer, only shared memory is removed
+	if (journal_dir != NULL) {
+		debug("Syncing journal and unmapping ring file");
+		if (journal_close(&journal, shared_buffer) == -1) error_handle();
+		if (journal_unmap_ring(shared_buffer) == -1) error_handle();
+	} else {
+		debug("Unmapping and unlinking shared memory");
+		if (ipc_segment_close(&segment) == -1) error_handle();
+	}
 
-	debug("Unlinking used semaphore");
-	if (sem_unlink(SEMAPHORE_USED_NAME) == -1) error_handle();
+	debug("Closing and unlinking semaphores");
+	if (ipc_sem_close(&free_slots) == -1) error_handle();
+	if (ipc_sem_close(&used_slots) == -1) error_handle();
 }
 
 
 int main(int argc, char **argv) {
+	int node = -1; // NUMA node for the writer and a shared memory ring, -1 leaves placement to the kernel
+	char *end;
+	int c;
+	while ((c = getopt(argc, argv, "j:N:")) != -1) {
+		switch (c) {
+			case 'j': journal_dir = optarg;
+				break;
+			case 'N':
+				node = strtol(optarg, &end, 10);
+				if (*optarg == '\0' || *end != '\0' || node < 0) usage();
+				break;
+			case '?': usage();
+				break;
+		}
+	}
 
-	// Set up shared memory for the circ buff
-	debug("Creating shared memory with name: %s", SHARED_MEM_NAME);
-	int shm_fd = shm_open(SHARED_MEM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
-	if (shm_fd == -1) error_handle();
-
-	debug("Truncating shared memory object and mapping shared buffer");
-	if (ftruncate(shm_fd, sizeof(SharedBuffer)) < 0) error_handle();
-	SharedBuffer *shared_buffer = mmap(0, sizeof(SharedBuffer), PROT_READ | PROT_WRITE, \
-		MAP_SHARED, shm_fd, 0);
-	if (shared_buffer == MAP_FAILED) error_handle();
-
-
-	// debug("Closing shared memory file descriptor");
-	// if (close(shm_fd) == -1) error_handle();
+	// Pinned first, so whatever the writer touches first is local to the node
+	if (node != -1 && ipc_pin_to_node(node) == -1) error_handle();
+
+	SharedBuffer *shared_buffer;
+	unsigned long unread = 0;
+	if (journal_dir == NULL) {
+		// Set up shared memory for the circ buff
+		debug("Creating shared memory in namespace %s", IPC_NAMESPACE);
+		if (ipc_segment_create(&segment, IPC_NAMESPACE, "shm", sizeof(SharedBuffer), \
+				IPC_PREFAULT | IPC_LOCK) == -1)
+			error_handle();
+		shared_buffer = segment.addr;
+		if (node != -1 && ipc_segment_bind(&segment, node) == -1) error_handle();
+	} else {
+		debug("Journal mode, mapping ring file in %s", journal_dir);
+		bool created;
+		shared_buffer = journal_map_ring(journal_dir, true, &created);
+		if (shared_buffer == NULL) error_handle();
+		journal_init(&journal, journal_dir, true);
+
+		// Values nobody read before the last shutdown are still in the ring
+		unread = shared_buffer->wr_seq - shared_buffer->rd_seq;
+		if (unread > BUF_LEN) {
+			fprintf(stderr, "Writer: ring file in %s is corrupt, %lu unread values in %d slots\n", \
+				journal_dir, unread, BUF_LEN);
+			exit(EXIT_FAILURE);
+		}
+		if (!created)
+			printf("Writer: resuming journal at offset %lu, %lu unread values\n", \
+				shared_buffer->wr_seq, unread);
+		unlink_stale_semaphore("free");
+		unlink_stale_semaphore("used");
+	}
 
 	debug("Creating Semaphores");
-	sem_t *res_free = sem_open(SEMAPHORE_FREE_NAME, O_CREAT | O_EXCL, 0666, BUF_LEN); 
-	sem_t *used = sem_open(SEMAPHORE_USED_NAME, O_CREAT | O_EXCL, 0666, 0); // no used
-	if (res_free == SEM_FAILED || used == SEM_FAILED) error_handle();
+	if (ipc_sem_create(&free_slots, IPC_NAMESPACE, "free", BUF_LEN - unread) == -1) error_handle();
+	if (ipc_sem_create(&used_slots, IPC_NAMESPACE, "used", unread) == -1) error_handle(); // no used unless resumed
+	sem_t *res_free = free_slots.sem, *used = used_slots.sem;
 
 
 	void handle_signal(int signal) {
 		debug("SIGINT received. Freeing resources");
-		free_resources(shared_buffer, res_free, used);
+		free_resources(shared_buffer);
 		exit(0);
 	}
 
@@ -120,7 +165,7 @@ int main(int argc, char **argv) {
 		sleep(1);
 	}
 
-	free_resources(shared_buffer, res_free, used);
+	free_resources(shared_buffer);
 
 	return 0;
 }
@@ -0,0 +1,184 @@
+/**
+ * @file pingpong.c
+ *
+ * @brief Measures the round trip of a handoff between two processes
+ *
+ * @details Forks a child and passes the turn back and forth rounds times, the parent
+ *          times every round trip. futex uses the turn word of turn.c, sem a pair of
+ *          named POSIX semaphores like processA and processB used to alternate before. Without -m
+ *          both are measured one after the other. The first PINGPONG_WARMUP rounds aren't
+ *          counted.
+ *
+ * @synopsis
+ *		pingpong [-n rounds] [-m futex|sem] [-s spin]
+ * @param -n  Round trips to time, 100000 by default.
+ * @param -m  Only measure one of the two.
+ * @param -s  Polls of the turn word before sleeping in the kernel, TURN_SPIN by default
+ *			  and 0 on a single CPU. 0 always sleeps.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <semaphore.h>
+#include <sys/wait.h>
+#include "turn.h"
+
+#define PINGPONG_WARMUP 1000
+#define PINGPONG_ROUNDS 100000
+
+enum mode {FUTEX, SEM, BOTH};
+
+void usage(void) {
+	fprintf(stderr, "Usage: \n\t pingpong [-n rounds] [-m futex|sem] [-s spin]\n");
+	exit(EXIT_FAILURE);
+}
+
+void handle_error(const char *msg) {
+	fprintf(stderr, "pingpong: %s Details: %s\n", msg, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+static long long now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int compare_ll(const void *a, const void *b) {
+	long long x = *(const long long *) a, y = *(const long long *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Prints the percentiles of the round trips, sorts them on the way
+ */
+void report(const char *name, long long rtt[], long rounds) {
+	qsort(rtt, rounds, sizeof(long long), compare_ll);
+	const double percentiles[] = {50, 90, 99, 99.9};
+	printf("%-6s %ld round trips, ns: min %lld", name, rounds, rtt[0]);
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+		printf(", p%g %lld", percentiles[i], rtt[(long) (percentiles[i] / 100 * (rounds - 1))]);
+	printf(", max %lld\n", rtt[rounds - 1]);
+}
+
+void wait_child(pid_t child) {
+	int status;
+	if (waitpid(child, &status, 0) == -1) handle_error("Failed to wait for the child.");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "pingpong: the child failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void measure_futex(long long rtt[], long rounds, long spin) {
+	IpcSegment segment;
+	Turn *turn = turn_create(&segment, NULL, 0);
+	if (turn == NULL) handle_error("Failed to create the turn word.");
+	if (spin >= 0) turn->spin = spin;
+	long total = rounds + PINGPONG_WARMUP;
+
+	pid_t child = fork();
+	if (child == -1) handle_error("Failed to fork.");
+	if (child == 0) {
+		for (long i = 0; i < total; i++) {
+			turn_wait(turn, 1);
+			turn_pass(turn, 1);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	for (long i = 0; i < total; i++) {
+		long long start = now_ns();
+		turn_pass(turn, 0);
+		turn_wait(turn, 0);
+		if (i >= PINGPONG_WARMUP) rtt[i - PINGPONG_WARMUP] = now_ns() - start;
+	}
+	wait_child(child);
+	ipc_segment_close(&segment);
+}
+
+void measure_sem(long long rtt[], long rounds) {
+	IpcSemaphore sem_1, sem_2;
+	if (ipc_sem_create(&sem_1, IPC_NAMESPACE, "sem_1", 0) == -1)
+		handle_error("Failed to create semaphores.");
+	if (ipc_sem_create(&sem_2, IPC_NAMESPACE, "sem_2", 0) == -1) {
+		ipc_sem_close(&sem_1);
+		handle_error("Failed to create semaphores.");
+	}
+	// The child inherits the handles, the names can go right away so no exit path leaves them behind
+	if (sem_unlink(sem_1.name) == -1 || sem_unlink(sem_2.name) == -1)
+		handle_error("Failed to unlink semaphores.");
+	sem_1.owner = sem_2.owner = false;
+	sem_t *s1 = sem_1.sem, *s2 = sem_2.sem;
+	long total = rounds + PINGPONG_WARMUP;
+
+	pid_t child = fork();
+	if (child == -1) handle_error("Failed to fork.");
+	if (child == 0) {
+		for (long i = 0; i < total; i++) {
+			while (sem_wait(s2) == -1 && errno == EINTR);
+			sem_post(s1);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	for (long i = 0; i < total; i++) {
+		long long start = now_ns();
+		sem_post(s2);
+		while (sem_wait(s1) == -1 && errno == EINTR);
+		if (i >= PINGPONG_WARMUP) rtt[i - PINGPONG_WARMUP] = now_ns() - start;
+	}
+	wait_child(child);
+	ipc_sem_close(&sem_1);
+	ipc_sem_close(&sem_2);
+}
+
+int main(int argc, char *argv[]) {
+	long rounds = PINGPONG_ROUNDS;
+	enum mode mode = BOTH;
+	long spin = -1; // the default of turn_create()
+
+	int c;
+	while ((c = getopt(argc, argv, "n:m:s:")) != -1) {
+		switch (c) {
+			case 'n':
+				rounds = strtol(optarg, NULL, 10);
+				if (rounds < 1) usage();
+				break;
+			case 'm':
+				if (strcmp(optarg, "futex") == 0)
+					mode = FUTEX;
+				else if (strcmp(optarg, "sem") == 0)
+					mode = SEM;
+				else
+					usage();
+				break;
+			case 's':
+				spin = strtol(optarg, NULL, 10);
+				if (spin < 0) usage();
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+
+	long long *rtt = malloc(rounds * sizeof(long long));
+	if (rtt == NULL) handle_error("Failed to allocate the round trips.");
+	if (mode != SEM) {
+		measure_futex(rtt, rounds, spin);
+		report("futex", rtt, rounds);
+	}
+	if (mode != FUTEX) {
+		measure_sem(rtt, rounds);
+		report("sem", rtt, rounds);
+	}
+	free(rtt);
+	return 0;
+}
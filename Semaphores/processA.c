@@ -1,20 +1,25 @@
 #include <stdio.h>
-#include <unistd.h>
-#include <semaphore.h>
-#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "turn.h"
 
-#define SEM_1 "/sem_1"
-#define SEM_2 "/sem_2"
+#define TURN_OBJECT "turn"
 
 int main(int argc, char **argv) {
-	sem_t *s1 = sem_open(SEM_1, O_CREAT | O_EXCL, 0600, 1);
-	sem_t *s2 = sem_open(SEM_2, O_CREAT | O_EXCL, 0600, 0);
+	IpcSegment segment;
+	Turn *turn = turn_create(&segment, TURN_OBJECT, 0);
+	if (turn == NULL) {
+		fprintf(stderr, "%s: Failed to create %s: %s\n", argv[0], segment.name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 
 	for (int i = 0; i < 3; i++) {
-		sem_wait(s1);
+		turn_wait(turn, 0);
 		printf("Critical: %s: i = %d\n", argv[0], i);
-		sem_post(s2);
+		fflush(stdout);
+		turn_pass(turn, 0);
 	}
-	sem_close(s1); sem_close(s2);
+	ipc_segment_close(&segment);
 	return 0;
 }
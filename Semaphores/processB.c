@@ -1,23 +1,27 @@
 #include <stdio.h>
-#include <unistd.h>
-#include <semaphore.h>
-#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "turn.h"
 
-#define SEM_1 "/sem_1"
-#define SEM_2 "/sem_2"
+#define TURN_OBJECT "turn"
 
 int main(int argc, char **argv) {
-  sem_t *s1 = sem_open(SEM_1, 0);
-    sem_t *s2 = sem_open(SEM_2, 0);
+	IpcSegment segment;
+	Turn *turn = turn_open(&segment, TURN_OBJECT);
+	if (turn == NULL) {
+		fprintf(stderr, "%s: Failed to open %s, is processA running? %s\n", argv[0], segment.name,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 
-        for (int i = 0; i < 3; i++) {
-            sem_wait(s2);
-                printf("Critical: %s:", argv[0]);
-                    printf("i = %d\n", i);
-                        sleep(1);
-                            sem_post(s1);    
-                              }
-                                sem_close(s1); sem_close(s2);
-                                  sem_unlink(SEM_1); sem_unlink(SEM_2);
-                                  return 0;
-                                  }
+	for (int i = 0; i < 3; i++) {
+		turn_wait(turn, 1);
+		printf("Critical: %s: i = %d\n", argv[0], i);
+		fflush(stdout);
+		turn_pass(turn, 1);
+	}
+	// processA created the turn word and removes it
+	ipc_segment_close(&segment);
+	return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file token_ring.c
+ *
+ * @brief A token passed between N processes in a fixed order, over one shared segment
+ *
+ * @details Generalizes the turn word of turn.c from two sides to any number of
+ *          participants without a named semaphore per direction. Each participant waits
+ *          on its own futex word, the holder passes the token by clearing its word and
+ *          setting the one of the next participant in the order. The order either goes
+ *          round robin or repeats participants according to weights, so a run is the
+ *          same sequence of holds every time.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "token_ring.h"
+#include <errno.h>
+
+/**
+ * @brief Spreads participants over a cycle in proportion to their weights
+ *
+ * @details Smooth weighted round robin: every position each participant gains its weight,
+ *          the one with the most credit takes the position and pays the total. A heavy
+ *          participant gets its holds spread over the cycle instead of in one run.
+ *
+ * @return length of the cycle, the sum of the weights, or -1 if it exceeds max or is 0
+ */
+int token_ring_weighted_order(const unsigned int weights[], int participants, int order[], int max) {
+	long total = 0;
+	for (int i = 0; i < participants; i++)
+		total += weights[i];
+	if (total == 0 || total > max) return -1;
+
+	long credit[RING_MAX_PARTICIPANTS] = {0};
+	for (long p = 0; p < total; p++) {
+		int best = -1;
+		for (int i = 0; i < participants; i++) {
+			credit[i] += weights[i];
+			if (weights[i] > 0 && (best == -1 || credit[i] > credit[best])) best = i;
+		}
+		credit[best] -= total;
+		order[p] = best;
+	}
+	return total;
+}
+
+/**
+ * @brief Creates the ring, order[0] holds the token first
+ *
+ * @param object Name within IPC_NAMESPACE, NULL for an anonymous mapping that only
+ *               children forked afterwards share
+ * @param order Participants in the order they hold the token, NULL for round robin
+ * @return the ring or NULL with errno set, EINVAL for a bad order. ipc_segment_close()
+ *         removes it again
+ */
+TokenRing *token_ring_create(IpcSegment *segment, const char *object, int participants, const int order[],
+		int order_len, unsigned int batch) {
+	if (participants < 1 || participants > RING_MAX_PARTICIPANTS) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (order == NULL) order_len = participants;
+	if (order_len < 1 || order_len > RING_MAX_ORDER) {
+		errno = EINVAL;
+		return NULL;
+	}
+	for (int p = 0; order != NULL && p < order_len; p++) {
+		if (order[p] < 0 || order[p] >= participants) {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	if (ipc_segment_create(segment, IPC_NAMESPACE, object, sizeof(TokenRing), IPC_PREFAULT) == -1)
+		return NULL;
+	TokenRing *ring = segment->addr;
+	ring->participants = participants;
+	ring->order_len = order_len;
+	ring->batch = batch;
+	ring->spin = default_spin();
+	atomic_init(&ring->stopped, false);
+	ring->position = 0;
+	ring->passes = 0;
+	for (int p = 0; p < order_len; p++)
+		ring->order[p] = order != NULL ? order[p] : p;
+	for (int i = 0; i < participants; i++) {
+		atomic_init(&ring->slots[i].holding, 0);
+		atomic_init(&ring->slots[i].sleeping, 0);
+		ring->slots[i].holds = 0;
+	}
+	atomic_store(&ring->slots[ring->order[0]].holding, 1);
+	return ring;
+}
+
+/**
+ * @brief Maps a ring another process created with token_ring_create()
+ *
+ * @return the ring or NULL with errno set
+ */
+TokenRing *token_ring_open(IpcSegment *segment, const char *object) {
+	if (ipc_segment_open(segment, IPC_NAMESPACE, object, sizeof(TokenRing), IPC_PREFAULT) == -1) return NULL;
+	return segment->addr;
+}
+
+/**
+ * @brief Returns once participant me holds the token
+ *
+ * @details Same protocol as turn_wait(): poll, then announce sleeping and sleep on the
+ *          word until the holder set it.
+ *
+ * @return false if the ring was stopped, the caller holds nothing then
+ */
+bool token_ring_wait(TokenRing *ring, int me) {
+	RingSlot *slot = &ring->slots[me];
+	for (unsigned int i = 0; i < ring->spin; i++) {
+		if (atomic_load_explicit(&slot->holding, memory_order_acquire)) break;
+		cpu_relax();
+	}
+
+	if (!atomic_load_explicit(&slot->holding, memory_order_acquire)) {
+		atomic_store(&slot->sleeping, 1);
+		while (!atomic_load(&slot->holding))
+			futex(&slot->holding, FUTEX_WAIT, 0);
+		atomic_store_explicit(&slot->sleeping, 0, memory_order_relaxed);
+	}
+	if (atomic_load(&ring->stopped)) return false;
+	slot->holds++;
+	return true;
+}
+
+/**
+ * @brief Hands the token to the next participant of the order, me must hold it
+ */
+void token_ring_pass(TokenRing *ring, int me) {
+	ring->passes++;
+	ring->position = (ring->position + 1) % ring->order_len;
+	RingSlot *next = &ring->slots[ring->order[ring->position]];
+
+	// The next holder may be me again, clearing first keeps its token
+	atomic_store_explicit(&ring->slots[me].holding, 0, memory_order_relaxed);
+	atomic_store(&next->holding, 1);
+	if (atomic_load(&next->sleeping))
+		futex(&next->holding, FUTEX_WAKE, 1);
+}
+
+/**
+ * @brief Ends the ring, every waiting and later token_ring_wait() returns false
+ */
+void token_ring_stop(TokenRing *ring) {
+	atomic_store(&ring->stopped, true);
+	for (int i = 0; i < ring->participants; i++) {
+		atomic_store(&ring->slots[i].holding, 1);
+		futex(&ring->slots[i].holding, FUTEX_WAKE, 1);
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef TOKEN_RING_H
+#define TOKEN_RING_H
+
+#include <stdbool.h>
+#include "turn.h"
+
+#define RING_MAX_PARTICIPANTS 64
+#define RING_MAX_ORDER 1024 // positions of one cycle, a weighted order repeats participants
+
+/* Wait word of one participant, 1 while it holds the token. Every participant polls
+   only its own word, so each gets a cache line of its own */
+typedef struct {
+	_Alignas(TURN_CACHE_LINE) atomic_uint holding;
+	atomic_uint sleeping;
+	unsigned long holds; // written by the participant only
+} RingSlot;
+
+/* One token passed along order[0], order[1], ... and around again. position is the
+   index into order of the current holder and passes the holds so far, both are only
+   touched by the holder. batch is the number of operations a participant does per
+   hold, the ring only stores it for everyone */
+typedef struct {
+	int participants;
+	int order_len;
+	unsigned int batch;
+	unsigned int spin;
+	atomic_bool stopped;
+	int position;
+	unsigned long passes;
+	int order[RING_MAX_ORDER];
+	RingSlot slots[RING_MAX_PARTICIPANTS];
+} TokenRing;
+
+int token_ring_weighted_order(const unsigned int weights[], int participants, int order[], int max);
+
+TokenRing *token_ring_create(IpcSegment *segment, const char *object, int participants, const int order[],
+	int order_len, unsigned int batch);
+TokenRing *token_ring_open(IpcSegment *segment, const char *object);
+
+bool token_ring_wait(TokenRing *ring, int me);
+void token_ring_pass(TokenRing *ring, int me);
+void token_ring_stop(TokenRing *ring);
+
+#endif
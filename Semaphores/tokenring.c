@@ -0,0 +1,169 @@
+/**
+ * @file tokenring.c
+ *
+ * @brief Runs a round robin pipeline of processes on a token ring
+ *
+ * @details Forks one process per participant. The holder of the token does batch
+ *          operations and passes the token on, until holds tokens were held in total.
+ *          Every operation appends the participant to a shared trace, which ends up the
+ *          same in every run. Prints how often each participant held the token and the
+ *          time per handoff.
+ *
+ * @synopsis
+ *		tokenring [-n participants] [-k batch] [-t holds] [-w weights] [-v]
+ * @param -n  Processes in the ring, 4 by default.
+ * @param -k  Operations per hold, 1 by default.
+ * @param -t  Holds in total, 100000 by default.
+ * @param -w  Comma separated weights, participant i gets the token weight i times per
+ *			  cycle. Round robin without.
+ * @param -v  Print the trace of the first cycles.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "token_ring.h"
+
+#define TRACE_LEN 64 // operations kept for -v
+
+typedef struct {
+	atomic_ulong operations;
+	int trace[TRACE_LEN];
+} Pipeline;
+
+void usage(void) {
+	fprintf(stderr, "Usage: \n\t tokenring [-n participants] [-k batch] [-t holds] [-w weights] [-v]\n");
+	exit(EXIT_FAILURE);
+}
+
+void handle_error(const char *msg) {
+	fprintf(stderr, "tokenring: %s Details: %s\n", msg, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Parses "w1,w2,..." into weights
+ *
+ * @return the number of weights or -1 if one isn't a number
+ */
+int parse_weights(char *str, unsigned int weights[]) {
+	int count = 0;
+	for (char *tok = strtok(str, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		char *end;
+		long weight = strtol(tok, &end, 10);
+		if (*end != '\0' || weight < 0 || count == RING_MAX_PARTICIPANTS) return -1;
+		weights[count++] = weight;
+	}
+	return count;
+}
+
+void run_participant(TokenRing *ring, Pipeline *pipeline, int me, unsigned long holds) {
+	while (token_ring_wait(ring, me)) {
+		for (unsigned int i = 0; i < ring->batch; i++) {
+			unsigned long op = atomic_fetch_add_explicit(&pipeline->operations, 1, memory_order_relaxed);
+			if (op < TRACE_LEN) pipeline->trace[op] = me;
+		}
+		if (ring->passes + 1 >= holds)
+			token_ring_stop(ring);
+		else
+			token_ring_pass(ring, me);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int participants = 4;
+	unsigned int batch = 1;
+	unsigned long holds = 100000;
+	unsigned int weights[RING_MAX_PARTICIPANTS];
+	int weight_count = 0;
+	bool verbose = false;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:k:t:w:v")) != -1) {
+		switch (c) {
+			case 'n':
+				participants = strtol(optarg, NULL, 10);
+				if (participants < 1 || participants > RING_MAX_PARTICIPANTS) usage();
+				break;
+			case 'k':
+				batch = strtoul(optarg, NULL, 10);
+				if (batch < 1) usage();
+				break;
+			case 't':
+				holds = strtoul(optarg, NULL, 10);
+				if (holds < 1) usage();
+				break;
+			case 'w':
+				weight_count = parse_weights(optarg, weights);
+				if (weight_count < 1) usage();
+				break;
+			case 'v': verbose = true;
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+
+	int order[RING_MAX_ORDER];
+	int order_len = 0;
+	if (weight_count > 0) {
+		if (weight_count != participants) {
+			fprintf(stderr, "tokenring: %d weights for %d participants\n", weight_count, participants);
+			exit(EXIT_FAILURE);
+		}
+		order_len = token_ring_weighted_order(weights, participants, order, RING_MAX_ORDER);
+		if (order_len == -1) {
+			fprintf(stderr, "tokenring: the weights have to sum up to 1 .. %d\n", RING_MAX_ORDER);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	IpcSegment ring_segment, pipeline_segment;
+	TokenRing *ring = token_ring_create(&ring_segment, NULL, participants, weight_count > 0 ? order : NULL,
+		order_len, batch);
+	if (ring == NULL) handle_error("Failed to create the token ring.");
+	if (ipc_segment_create(&pipeline_segment, IPC_NAMESPACE, NULL, sizeof(Pipeline), 0) == -1)
+		handle_error("Failed to map the pipeline.");
+	Pipeline *pipeline = pipeline_segment.addr;
+	atomic_init(&pipeline->operations, 0);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < participants; i++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			token_ring_stop(ring);
+			handle_error("Failed to fork.");
+		}
+		if (pid == 0) {
+			run_participant(ring, pipeline, i, holds);
+			_exit(EXIT_SUCCESS);
+		}
+	}
+	while (wait(NULL) > 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%lu holds of %u operations in %.3f s, %.0f ns per handoff\n", ring->passes + 1, batch,
+		elapsed / 1e9, elapsed / (ring->passes + 1));
+	for (int i = 0; i < participants; i++)
+		printf("participant %d: %lu holds\n", i, ring->slots[i].holds);
+	if (verbose) {
+		unsigned long traced = atomic_load(&pipeline->operations);
+		if (traced > TRACE_LEN) traced = TRACE_LEN;
+		printf("trace:");
+		for (unsigned long op = 0; op < traced; op++)
+			printf(" %d", pipeline->trace[op]);
+		printf("\n");
+	}
+
+	ipc_segment_close(&pipeline_segment);
+	ipc_segment_close(&ring_segment);
+	return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file turn.c
+ *
+ * @brief Turn taking of two processes on a futex word in shared memory
+ *
+ * @details Replaces the pair of named semaphores processA and processB used to alternate.
+ *          A handoff is one store to the turn word. The waiting side polls it TURN_SPIN
+ *          times, which is enough while the other side only does a short step, and then
+ *          sleeps on it with FUTEX_WAIT. On a single CPU it sleeps right away. The futex
+ *          is not private, the word lives in a MAP_SHARED mapping that both processes see.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "turn.h"
+/**
+ * @brief Creates the shared turn word in segment, side first may run first
+ *
+ * @param object Name within IPC_NAMESPACE, NULL for an anonymous mapping that only
+ *               children forked afterwards share
+ * @return the turn word or NULL with errno set, ipc_segment_close() removes it again
+ */
+Turn *turn_create(IpcSegment *segment, const char *object, int first) {
+	if (ipc_segment_create(segment, IPC_NAMESPACE, object, sizeof(Turn), IPC_PREFAULT) == -1) return NULL;
+	Turn *turn = segment->addr;
+	atomic_init(&turn->turn, first);
+	atomic_init(&turn->sleeping[0], 0);
+	atomic_init(&turn->sleeping[1], 0);
+	turn->spin = default_spin();
+	return turn;
+}
+
+/**
+ * @brief Maps a turn word another process created with turn_create()
+ *
+ * @return the turn word or NULL with errno set
+ */
+Turn *turn_open(IpcSegment *segment, const char *object) {
+	if (ipc_segment_open(segment, IPC_NAMESPACE, object, sizeof(Turn), IPC_PREFAULT) == -1) return NULL;
+	return segment->addr;
+}
+
+/**
+ * @brief Returns once it is the turn of side
+ *
+ * @details sleeping is set before the last look at the turn word and the passer stores
+ *          the turn before it looks at sleeping. Both are sequentially consistent, so
+ *          either the waiter sees the new turn or the passer sees it sleeping and wakes
+ *          it. FUTEX_WAIT itself returns at once if the word changed in between.
+ */
+void turn_wait(Turn *turn, int side) {
+	for (unsigned int i = 0; i < turn->spin; i++) {
+		if (atomic_load_explicit(&turn->turn, memory_order_acquire) == (unsigned int) side) return;
+		cpu_relax();
+	}
+
+	atomic_store(&turn->sleeping[side], 1);
+	unsigned int current;
+	while ((current = atomic_load(&turn->turn)) != (unsigned int) side)
+		futex(&turn->turn, FUTEX_WAIT, current); // EAGAIN and EINTR just mean look again
+	atomic_store_explicit(&turn->sleeping[side], 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Hands the turn from side to the other side, side must hold it
+ */
+void turn_pass(Turn *turn, int side) {
+	int other = !side;
+	atomic_store(&turn->turn, other);
+	if (atomic_load(&turn->sleeping[other]))
+		futex(&turn->turn, FUTEX_WAKE, 1);
+}
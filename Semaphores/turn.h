@@ -0,0 +1,45 @@
+#ifndef TURN_H
+#define TURN_H
+
+#include <stdatomic.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "ipc.h"
+
+#define TURN_SPIN 4000 // polls of the turn word before a waiter sleeps in the kernel
+#define TURN_CACHE_LINE 64
+#define IPC_NAMESPACE "semaphores"
+
+static inline long futex(atomic_uint *word, int op, unsigned int val) {
+	return syscall(SYS_futex, word, op, val, NULL, NULL, 0);
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+// Spinning only pays off if the other side runs meanwhile on another CPU
+static inline unsigned int default_spin(void) {
+	return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? TURN_SPIN : 0;
+}
+
+/* Strict alternation of two processes, side 0 and side 1, over one shared mapping.
+   turn is the futex word and holds the side that may run. sleeping[side] is set while
+   that side waits in the kernel, so passing the turn only makes a syscall if the other
+   side gave up spinning. turn sits on a line of its own, the waiter polls it */
+typedef struct {
+	_Alignas(TURN_CACHE_LINE) atomic_uint turn;
+	_Alignas(TURN_CACHE_LINE) atomic_uint sleeping[2];
+	unsigned int spin; // TURN_SPIN, or 0 on a single CPU
+} Turn;
+
+Turn *turn_create(IpcSegment *segment, const char *object, int first);
+Turn *turn_open(IpcSegment *segment, const char *object);
+
+void turn_wait(Turn *turn, int side);
+void turn_pass(Turn *turn, int side);
+
+#endif
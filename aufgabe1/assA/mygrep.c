@@ -1,13 +1,21 @@
 /**
  * @file mygrep.c
  * @brief This file implements a custom grep utility for searching keywords in files/stdin
- * @details This utility makes a line-by-line search for a specified by user keyword either
- *    	    case-sensitive or insesitive in multiple/signle files or from stdin stream
+ * @details This utility searches for a specified by user keyword either case-sensitive
+ *    	    or insesitive in multiple/signle files or from stdin stream. Files are mapped
+ *    	    and scanned as one buffer for the keyword instead of line by line, lines are
+ *    	    only looked at around matches. Line numbers are counted lazily over the spans
+ *    	    between printed lines. Stdin is read in large blocks that are scanned the
+ *    	    same way, so mygrep keeps up as a filter in a pipeline.
  *
  * @synopsis
- *		mygrep [-i] [-o outfile] keyword [file...]
+ *		mygrep [-i] [-n] [-A num] [-B num] [-C num] [-o outfile] keyword [file...]
  *
  * @param -i Perform a case-insensitive search.
+ * @param -n Prefix every printed line with its line number
+ * @param -A Print num lines of context after every matching line
+ * @param -B Print num lines of context before every matching line
+ * @param -C Print num lines of context before and after, unless -A or -B say otherwise
  * @param -o Specify an output file to save search results
  * @param keyword The keyword to search for in each line of the files/stdin
  * @param file One or more files to search. If omitted, reads from stdin stream
@@ -24,6 +32,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mygrep.h"
 
 #define STR_SIZE (128) /**< Maximum number of characters in keyword/file_path */
 #define MAX_FILES (50) /**< Maximum amount of possible input files */
@@ -45,10 +61,6 @@
 #define debug(msg, ...)
 #endif
 
-// Function prototypes
-void readFile_andSearch(FILE *file ,char* keyword, const char* outfile, int i_arg);
-int writeLine_toFile(const char *path, char* line);
-
 
 /**
  * @brief   Prints the usage information for the mygrep utility
@@ -61,25 +73,49 @@ int writeLine_toFile(const char *path, char* line);
  * @date    2024-11-08
  */
 void usage(void) {
-    fprintf(stderr, "Usage mygrep [-i] [-o outfile] keyword [file...]\n");
+    fprintf(stderr, "Usage mygrep [-i] [-n] [-A num] [-B num] [-C num] [-o outfile] keyword [file...]\n");
     exit(EXIT_FAILURE);
 }
 
 
+/**
+ * @brief parses the number of context lines given to -A, -B or -C
+ *
+ * @return the number, exits through usage() unless it is a number up to MAX_CONTEXT
+ */
+long parseContext(const char *arg) {
+    char *end;
+    errno = 0;
+    long lines = strtol(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || lines < 0 || lines > MAX_CONTEXT)
+        usage();
+    return lines;
+}
+
+
 
 int main(int argc, char* argv[]) {
 
     debug("Program started", NULL);
     char *outfile = NULL;
-    int opt_i = 0;
+    int opt_i = 0, opt_n = 0;
+    long opt_a = -1, opt_b = -1, opt_c = -1;
     int c;
 
-    while ( (c = getopt(argc, argv, "io:")) != -1) {
+    while ( (c = getopt(argc, argv, "inA:B:C:o:")) != -1) {
         switch (c) {
             case 'o': outfile = optarg;
                 break;
             case 'i': opt_i++;
                 break;
+            case 'n': opt_n = 1;
+                break;
+            case 'A': opt_a = parseContext(optarg);
+                break;
+            case 'B': opt_b = parseContext(optarg);
+                break;
+            case 'C': opt_c = parseContext(optarg);
+                break;
             case '?': usage();
                 break;
         }
@@ -122,130 +158,416 @@ int main(int argc, char* argv[]) {
         debug("Abnormal amount of -i arguments: %d times\n", opt_i);
         usage();
     }
+
+    SearchOptions opts = {
+        .keyword = keyword,
+        .keyword_len = strlen(keyword),
+        .i_arg = opt_i,
+        .n_arg = opt_n,
+        .before = opt_b >= 0 ? opt_b : opt_c >= 0 ? opt_c : 0,
+        .after = opt_a >= 0 ? opt_a : opt_c >= 0 ? opt_c : 0,
+        .separate = opt_a >= 0 || opt_b >= 0 || opt_c >= 0,
+        .out = stdout
+    };
+
+    // The outfile is cleared once, results of all files are appended to it
     if (outfile == NULL) {
         debug("Outfile was not speicifed", NULL);
-    } else
+        struct stat st;
+        opts.splice_out = !opt_n && fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode);
+    } else {
         debug("Outfile was specified: %s", outfile);
+        opts.out = fopen(outfile, "w");
+        if (opts.out == NULL) {
+            fprintf(stderr, "Failed to open the output file, error: %s", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
 
     if (opt_i == 1) {
         for (int i=0; i < strlen(keyword); i++)
             keyword[i] = tolower(keyword[i]);}
-    if (files_amount > 0) {
-        FILE *in;
-        for (int file = 0; file < files_amount; file++) {
-            debug("Reading file: %s", files[file]);
-            if (strcmp(files[file], "stdin")==0)
-                in = stdin;
-            else
-                in = fopen(files[file], "r");
-            readFile_andSearch(in, keyword, outfile, opt_i);
-        }
+    for (int file = 0; file < files_amount; file++) {
+        debug("Reading file: %s", files[file]);
+        readFile_andSearch(files[file], &opts);
     }
 
+    if (fclose(opts.out) == EOF) {
+        fprintf(stderr, "Failed to write the results, error: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
     return 0;
 }
 
 
 /**
- * @brief reads file and searches keyword
+ * @brief counts the newlines in a buffer
  *
- * @details This module takes a file, searches (case sensitivity may be specified) for a
- *          keyword in each line and in case an outfile was specified is going to append
- *          it with the line containing the keyword
+ * @details Compares 16 bytes at a time against '\n' with SSE2 and adds the matches up in
+ *          16 byte sized counters, which are summed up every 255 blocks before they could
+ *          overflow. The tail and machines without SSE2 go byte by byte.
  *
- * @param file the FILE datatype pointer that is going to be read.
- * @param keyword keyword that is going to be searched in each line of the "*file".
- * @param outfile file path to an output file that is going to contain search
- *		          result. if not specified (or set to NULL) will outoput to stdout.
- * @param i_arg practically should be a boolean value that if set to 1 will make a
- *				case insensitive search (no matter if upper case or lower case).
+ * @param buf the buffer to count in
+ * @param len the length of buf in bytes
  *
  * @author Volodymyr Skoryi
  * @date   2024-11-08
  *
- * @return void
+ * @return the number of '\n' characters in buf
  */
-void readFile_andSearch(FILE *file, char* keyword, const char* outfile, int i_arg) {
-    // FILE * fp;
-    char * line = NULL;
-    size_t len = 0;
-    ssize_t read;
-
-    // fp = fopen(path, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Error openening file: %s", strerror(errno));
-        fflush(stderr);
-        exit(EXIT_FAILURE);
+size_t countNewlines(const char *buf, size_t len) {
+    size_t count = 0, i = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (i + 16 <= len) {
+        __m128i counters = _mm_setzero_si128();
+        size_t stop = len - i > 255 * 16 ? i + 255 * 16 : len;
+        for (; i + 16 <= stop; i += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *) (buf + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(chunk, newline)); // a match is -1
+        }
+        __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+        count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
     }
+#endif
+    for (; i < len; i++)
+        count += buf[i] == '\n';
+    return count;
+}
 
-    // Ensure that outfile is empty
-    if (outfile != NULL) {
-        FILE *fp = fopen(outfile, "w");
-        if (fp != NULL) fclose(fp);
-        else {
-            fprintf(stderr, "Failed to open outfile for clearing purpose, %s", strerror(errno));
-            exit(EXIT_FAILURE);
+
+/* Finds the next occurrence of the keyword in [buf, buf + len), the keyword is lower case
+   for -i. With SSE2 candidates for -i are positions where both the first and the last
+   character match in either case, checked for 16 positions at a time. The tail and
+   machines without SSE2 find candidates with memchr for the first character */
+static const char *findKeyword(const char *buf, size_t len, const SearchOptions *opts) {
+    if (opts->i_arg == 0)
+        return memmem(buf, len, opts->keyword, opts->keyword_len);
+    if (opts->keyword_len == 0)
+        return buf;
+    if (len < opts->keyword_len)
+        return NULL;
+
+    const char *last = buf + len - opts->keyword_len; // last position a match can start at
+    char lower = opts->keyword[0], upper = toupper((unsigned char) lower);
+#ifdef __SSE2__
+    char last_lower = opts->keyword[opts->keyword_len - 1];
+    const __m128i first_lo = _mm_set1_epi8(lower), first_up = _mm_set1_epi8(upper);
+    const __m128i last_lo = _mm_set1_epi8(last_lower);
+    const __m128i last_up = _mm_set1_epi8(toupper((unsigned char) last_lower));
+    for (; buf + 16 <= last + 1; buf += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i *) buf);
+        __m128i tail = _mm_loadu_si128((const __m128i *) (buf + opts->keyword_len - 1));
+        __m128i candidates = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(head, first_lo), _mm_cmpeq_epi8(head, first_up)),
+            _mm_or_si128(_mm_cmpeq_epi8(tail, last_lo), _mm_cmpeq_epi8(tail, last_up)));
+        for (int mask = _mm_movemask_epi8(candidates); mask != 0; mask &= mask - 1) {
+            const char *candidate = buf + __builtin_ctz(mask);
+            if (strncasecmp(candidate + 1, opts->keyword + 1, opts->keyword_len - 1) == 0)
+                return candidate;
         }
     }
-    
-    while ((read = getline(&line, &len, file)) != -1) {
-        char *line_dup = strdup(line);
-        if (i_arg == 1) {
-            for (int i = 0; i < read; i++) {
-                line_dup[i] = tolower(line_dup[i]);
-            }
-        }
+    if (buf > last)
+        return NULL;
+#endif
+    const char *lo = memchr(buf, lower, last - buf + 1);
+    const char *up = lower == upper ? NULL : memchr(buf, upper, last - buf + 1);
+    while (lo != NULL || up != NULL) {
+        const char *candidate = (up == NULL || (lo != NULL && lo < up)) ? lo : up;
+        if (strncasecmp(candidate + 1, opts->keyword + 1, opts->keyword_len - 1) == 0)
+            return candidate;
+        if (candidate == lo)
+            lo = lo < last ? memchr(lo + 1, lower, last - lo) : NULL;
+        else
+            up = up < last ? memchr(up + 1, upper, last - up) : NULL;
+    }
+    return NULL;
+}
 
-        if (strstr(line_dup, keyword) != NULL) {
-            if (outfile != NULL) {
 
-                writeLine_toFile(outfile, line);
-            } else {
-                printf("%s", line);
+/* Returns the line number of the line starting at offset, only the newlines since the
+   last call are counted */
+static unsigned long lineNumber(const char *buf, size_t offset, SearchState *state) {
+    if (offset > state->counted_upto) {
+        state->lines += countNewlines(buf + state->counted_upto, offset - state->counted_upto);
+        state->counted_upto = offset;
+    }
+    return state->lines + 1;
+}
+
+
+/* Skips up to *count lines forward from offset without passing limit, *count is
+   decreased by the lines skipped */
+static size_t skipLines(const char *buf, size_t offset, size_t limit, size_t *count) {
+    while (*count > 0 && offset < limit) {
+        const char *nl = memchr(buf + offset, '\n', limit - offset);
+        offset = nl == NULL ? limit : (size_t) (nl - buf) + 1;
+        (*count)--;
+    }
+    return offset;
+}
+
+
+/* Steps back count lines from the line starting at offset, not further back than floor */
+static size_t backLines(const char *buf, size_t floor, size_t offset, size_t count) {
+    for (; count > 0 && offset > floor; count--) {
+        const char *nl = offset - 1 > floor ? memrchr(buf + floor, '\n', offset - 1 - floor) : NULL;
+        offset = nl == NULL ? floor : (size_t) (nl - buf) + 1;
+    }
+    return offset;
+}
+
+
+/* Writes the pending span of a mapped file. A long one is spliced from the page cache
+   into the stdout pipe without a copy, a short one isn't worth the system calls */
+static void flushPending(const char *buf, const SearchOptions *opts, SearchState *state) {
+    size_t from = state->pending_from, to = state->pending_to;
+    state->pending_from = state->pending_to = 0;
+
+    if (to - from >= SPLICE_MIN) {
+        fflush(opts->out);
+        loff_t offset = from;
+        while (offset < to) {
+            ssize_t sent = splice(state->splice_fd, &offset, STDOUT_FILENO, NULL, to - offset, SPLICE_F_MORE);
+            if (sent == -1 && errno == EINTR)
+                continue;
+            if (sent <= 0) {
+                debug("splice failed, writing the rest: %s", strerror(errno));
+                break;
             }
         }
-        free(line_dup);
+        from = offset;
+    }
+    fwrite(buf + from, 1, to - from, opts->out);
+}
 
+
+/* Writes [from, to) of the buffer, joining it to the pending span if splicing */
+static void writeSpan(const char *buf, size_t from, size_t to, const SearchOptions *opts,
+        SearchState *state) {
+    if (state->splice_fd == -1) {
+        fwrite(buf + from, 1, to - from, opts->out);
+        return;
     }
+    if (from != state->pending_to)
+        flushPending(buf, opts, state);
+    if (state->pending_from == state->pending_to)
+        state->pending_from = from;
+    state->pending_to = to;
+}
+
 
-    fclose(file);
-    if (line)
-        free(line);
+/* Prints the lines in [from, to) straight out of the buffer, sep follows the line number
+   with -n, ':' for matching lines and '-' for context */
+static void printLines(const char *buf, size_t from, size_t to, char sep, const SearchOptions *opts,
+        SearchState *state) {
+    if (from == to)
+        return;
+    if (opts->n_arg == 0) {
+        writeSpan(buf, from, to, opts, state);
+    } else {
+        unsigned long number = lineNumber(buf, from, state);
+        while (from < to) {
+            const char *nl = memchr(buf + from, '\n', to - from);
+            size_t end = nl == NULL ? to : (size_t) (nl - buf) + 1;
+            fprintf(opts->out, "%lu%c", number++, sep);
+            fwrite(buf + from, 1, end - from, opts->out);
+            from = end;
+        }
+    }
+    // The last line of a file may lack its newline, the next file's lines mustn't join it
+    if (buf[to - 1] != '\n') {
+        if (state->splice_fd != -1)
+            flushPending(buf, opts, state);
+        fputc('\n', opts->out);
+    }
+    state->printed_end = to;
+    state->printed_any = 1;
+    state->dropped = 0;
 }
 
 
 /**
- * @brief appends file with line 
+ * @brief searches a buffer of whole lines for the keyword and prints the matching lines
  *
- * @details this module takes as input a path to the output file, after which it appends it with a string.
+ * @details The keyword is searched in the whole buffer at once. Only for a match the
+ *          start and end of its line are looked up, and the context lines are found from
+ *          there by scanning back and forth for newlines. Nothing is copied, lines are
+ *          written straight out of buf. Without a match after them lines cost nothing but
+ *          the keyword search, with -n also the newline count.
  *
- * @param path is the path to the output file (where line is appended)
- * @param line is the line itself that is going to be appended to the file
+ * @param buf the lines to search, the last one doesn't need a '\n'
+ * @param len the length of buf in bytes
+ * @param opts what to search for and where to print it
+ * @param state zeroed for a new input, keeps the position between the calls
  *
  * @author Volodymyr Skoryi
- * @date 2024-11-08
- *
- * @return int either 1 or 0. 1 for successful execution, 0 for an error
+ * @date   2024-11-08
  */
-int writeLine_toFile(const char *path, char* line) {
+void searchBuffer(const char *buf, size_t len, const SearchOptions *opts, SearchState *state) {
+    size_t pos = state->searched;
+    const char *match;
+
+    while (pos < len && (match = findKeyword(buf + pos, len - pos, opts)) != NULL) {
+        const char *nl = memrchr(buf + pos, '\n', match - (buf + pos));
+        size_t start = nl == NULL ? pos : (size_t) (nl - buf) + 1;
+        nl = memchr(match, '\n', len - (match - buf));
+        size_t end = nl == NULL ? len : (size_t) (nl - buf) + 1;
+
+        // After context of the previous match runs up to this line at most
+        size_t context_end = skipLines(buf, state->printed_end, start, &state->after_left);
+        printLines(buf, state->printed_end, context_end, '-', opts, state);
+
+        size_t context_start = backLines(buf, context_end, start, opts->before);
+        if (opts->separate && state->printed_any
+                && (context_start > context_end || (context_start == 0 && state->dropped))) {
+            if (state->splice_fd != -1)
+                flushPending(buf, opts, state);
+            fputs("--\n", opts->out);
+        }
+        printLines(buf, context_start, start, '-', opts, state);
+        printLines(buf, start, end, ':', opts, state);
+
+        state->after_left = opts->after;
+        pos = end;
+    }
 
-    FILE *fp = fopen(path, "a");
-    int res;
+    size_t context_end = skipLines(buf, state->printed_end, len, &state->after_left);
+    printLines(buf, state->printed_end, context_end, '-', opts, state);
+    state->searched = len;
+}
+
+
+/* Allocates a page aligned buffer of room bytes for carried over lines and a block behind */
+static char *allocBlocks(size_t room) {
+    void *buf;
+    if (posix_memalign(&buf, sysconf(_SC_PAGESIZE), room + BLOCK_SIZE) != 0)
+        return NULL;
+    return buf;
+}
 
-    if (fp == NULL) {
-        fprintf(stderr, "Failed to open the output file, error: %s", strerror(errno));
+
+/**
+ * @brief searches a stream that can't be mapped, like stdin, block by block
+ *
+ * @details Every read fills a page aligned block of BLOCK_SIZE bytes. The complete lines
+ *          read so far are searched with searchBuffer(), the partial line at the end of the
+ *          block is carried over in front of the next block, together with the last -B lines
+ *          that could become context of a match in it. The carried lines are the only bytes
+ *          that get copied. A line longer than the room in front of the block makes the room
+ *          grow.
+ *
+ * @param fd the stream to read to its end
+ * @param path name of the stream for error messages
+ * @param opts what to search for and where to print the results
+ *
+ * @author Volodymyr Skoryi
+ * @date   2024-11-08
+ */
+void searchStream(int fd, const char *path, const SearchOptions *opts) {
+    size_t room = BLOCK_SIZE;
+    size_t carry = 0; // bytes carried over, they end where the block starts
+    char *base = allocBlocks(room);
+    SearchState state = {.splice_fd = -1};
+    if (base == NULL) {
+        fprintf(stderr, "Failed to allocate a buffer for %s, error: %s", path, strerror(errno));
         exit(EXIT_FAILURE);
-    } else {
-        res = fputs(line, fp);
-        if (res == EOF) {
-            fprintf(stderr, "Failed to append outfile, error: %s", strerror(errno));
-            fclose(fp);
-            return 0;
+    }
+
+    while (1) {
+        char *block = base + room;
+        ssize_t got = read(fd, block, BLOCK_SIZE);
+        if (got == -1 && errno == EINTR)
+            continue;
+        if (got == -1) {
+            fprintf(stderr, "Failed to read %s, error: %s", path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        char *buf = block - carry;
+        size_t len = carry + got;
+        if (got == 0) {
+            searchBuffer(buf, len, opts, &state); // the last line, if it lacks a newline
+            break;
+        }
+        const char *nl = memrchr(block, '\n', got);
+        size_t complete = nl == NULL ? state.searched : (size_t) (nl - buf) + 1;
+        searchBuffer(buf, complete, opts, &state);
+
+        // Keep the partial line and the lines that may be needed as context before a match
+        size_t keep = backLines(buf, state.printed_end, complete, opts->before);
+        if (opts->n_arg) {
+            lineNumber(buf, keep, &state);
+            state.counted_upto = 0;
+        }
+        if (keep > 0)
+            state.dropped = state.printed_end < keep;
+        state.printed_end = state.printed_end > keep ? state.printed_end - keep : 0;
+        state.searched -= keep;
+        carry = len - keep;
+
+        if (carry > room) {
+            size_t bigger = room;
+            while (bigger < carry)
+                bigger *= 2;
+            char *grown = allocBlocks(bigger);
+            if (grown == NULL) {
+                fprintf(stderr, "Failed to allocate a buffer for %s, error: %s", path, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            memcpy(grown + bigger - carry, buf + keep, carry);
+            free(base);
+            base = grown;
+            room = bigger;
         } else {
-            debug("Outfile succesfully appended, result: %d", res);
-            debug("\tString appended: %s", line);
-            fclose(fp);
-            return 1;
+            memmove(base + room - carry, buf + keep, carry);
         }
     }
+    free(base);
+}
+
+
+/**
+ * @brief reads file and searches keyword
+ *
+ * @details This module maps a regular file into memory and passes it to searchBuffer()
+ *          as a whole. Other files and stdin, that can't be mapped, go to searchStream().
+ *
+ * @param path path of the file to search, "stdin" for the stdin stream
+ * @param opts what to search for and where to print the results
+ *
+ * @author Volodymyr Skoryi
+ * @date   2024-11-08
+ *
+ * @return void
+ */
+void readFile_andSearch(const char *path, const SearchOptions *opts) {
+    int fd = strcmp(path, "stdin") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "Error openening file: %s", strerror(errno));
+        fflush(stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        SearchState state = {.splice_fd = opts->splice_out ? fd : -1};
+        if (st.st_size > 0) {
+            char *buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (buf == MAP_FAILED) {
+                fprintf(stderr, "Failed to map %s, error: %s", path, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            if (madvise(buf, st.st_size, MADV_SEQUENTIAL) == -1)
+                debug("madvise failed: %s", strerror(errno));
+            searchBuffer(buf, st.st_size, opts, &state);
+            if (state.splice_fd != -1)
+                flushPending(buf, opts, &state);
+            munmap(buf, st.st_size);
+        }
+    } else {
+        searchStream(fd, path, opts);
+    }
+
+    close(fd);
 }
@@ -1,7 +1,51 @@
 #ifndef MYGREP_H 
 #define MYGREP_H
 
-void readFile_andSearch(FILE *file, char* keyword, const char* outfile, int i_arg);
-int writeLine_toFile(const char *path, char* line);
+#include <stdio.h>
+#include <stddef.h>
+
+#define MAX_CONTEXT (1024) /**< Maximum number of context lines for -A, -B and -C */
+#define BLOCK_SIZE (1 << 20) /**< Bytes read at once from stdin and other streams, a multiple of the page size */
+#define SPLICE_MIN (1 << 16) /**< Printed spans of a mapped file from this long are spliced into a stdout pipe */
+
+/**
+ * @brief What to search for and how to print it, set once from the arguments
+ */
+typedef struct {
+    const char *keyword;
+    size_t keyword_len;
+    int i_arg;          /**< 1 for a case insensitive search, the keyword is lower case then */
+    int n_arg;          /**< 1 to prefix lines with their line number */
+    size_t before;      /**< context lines printed before a match */
+    size_t after;       /**< context lines printed after a match */
+    int separate;       /**< 1 if -A, -B or -C was given, groups of lines are separated by "--" */
+    FILE *out;          /**< stdout or the outfile, opened once for all files */
+    int splice_out;     /**< 1 if out is a stdout pipe and lines are printed without -n */
+} SearchOptions;
+
+/**
+ * @brief Where the search of one input stands
+ *
+ * @details Offsets are relative to the buffer passed to searchBuffer. Line numbers are
+ *          only counted up to the lines that get printed. A stream moves the lines it still
+ *          needs to the start of its buffer between blocks, the offsets move with them.
+ */
+typedef struct {
+    size_t searched;        /**< offset the search goes on from */
+    size_t printed_end;     /**< offset after the last printed line */
+    int dropped;            /**< unprinted lines before offset 0 were dropped by a stream */
+    size_t after_left;      /**< context lines still to print after the last match */
+    int printed_any;        /**< a group was printed, the next one gets a "--" separator */
+    size_t counted_upto;    /**< newlines before this offset are in lines */
+    unsigned long lines;    /**< newlines in [0, counted_upto) */
+    int splice_fd;          /**< mapped file to splice printed spans from, -1 to write them */
+    size_t pending_from;    /**< printed span not written yet, adjacent spans are joined */
+    size_t pending_to;
+} SearchState;
+
+void readFile_andSearch(const char *path, const SearchOptions *opts);
+void searchStream(int fd, const char *path, const SearchOptions *opts);
+void searchBuffer(const char *buf, size_t len, const SearchOptions *opts, SearchState *state);
+size_t countNewlines(const char *buf, size_t len);
 
 #endif
@@ -0,0 +1,371 @@
+/**
+ * @file bench.c
+ *
+ * @brief Benchmark of the solver strategies and the circular buffer on fixed graph families
+ *
+ * @details Builds random G(n,p) graphs, grids with diagonals (every cell gets one diagonal,
+ *          some both, which makes them K4s), graphs of many K4s joined by random edges and,
+ *          optionally, DIMACS .col files. Every graph is reduced like in the generator and each
+ *          strategy runs on it for a fixed time with a fixed seed, so two runs of the same
+ *          build search exactly the same colorings. Reported are the colorings (random) or
+ *          moves (tabu) or branches (exact) per second, the fewest conflicting edges found and
+ *          when they were found. Last, solutions are pushed through the ring of the supervisor
+ *          with the same semaphore protocol, measuring records per second.
+ *
+ * @synopsis
+ *		bench [-t seconds] [-s seed] [-p producers] [DIMACS_FILE ...]
+ * @param -t    Time each strategy gets per graph, 1 second by default.
+ * @param -s    Seed of the graph families and the searches, 1 by default.
+ * @param -p    Producer threads of the ring benchmark, 1 by default.
+ * @param DIMACS_FILE Graph with "p edge n m" and "e u v" lines, nodes numbered from 1.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "solver.h"
+#include "reduce.h"
+#include "exact.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define BENCH_RING_RECORDS 2000000UL /**< Solutions pushed through the ring per run */
+#define BENCH_LINE_LEN 256
+
+typedef struct {
+	char name[64];
+	EdgeList list;
+} Workload;
+
+typedef struct {
+	unsigned long steps; // colorings, moves or branches
+	double seconds;
+	double time_to_best;
+	long best;           // -1 if random found nothing with at most MAX_SOLUTION_EDGES edges
+	bool proven;
+} BenchResult;
+
+typedef struct {
+	SharedMemory *shm;
+	sem_t free_slots;
+	sem_t used_slots;
+	unsigned long records;
+} RingBench;
+
+double budget = 1.0;
+
+void usage(void) {
+	fprintf(stderr, "Usage: \n\t bench [-t seconds] [-s seed] [-p producers] [DIMACS_FILE ...]\n");
+	exit(EXIT_FAILURE);
+}
+
+void handle_error(const char *msg) {
+	fprintf(stderr, "bench: %s Details: %s\n", msg, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void add_edge(EdgeList *list, int u, int v) {
+	if (!edge_list_append(list, u, v)) handle_error("Failed to grow edge list.");
+}
+
+/* Uniform double in [0, 1) from the upper 53 bits */
+static double rng_double(Rng *rng) {
+	return (rng_next(rng) >> 11) * (1.0 / (1ULL << 53));
+}
+
+void make_gnp(Workload *workload, Rng *rng, int n, double p) {
+	snprintf(workload->name, sizeof(workload->name), "gnp n=%d p=%.3f", n, p);
+	for (int u = 0; u < n; u++) {
+		for (int v = u + 1; v < n; v++) {
+			if (rng_double(rng) < p) add_edge(&workload->list, u, v);
+		}
+	}
+}
+
+void make_grid(Workload *workload, Rng *rng, int width, int height, double both) {
+	snprintf(workload->name, sizeof(workload->name), "grid %dx%d k4=%.3f", width, height, both);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int v = y * width + x;
+			if (x + 1 < width) add_edge(&workload->list, v, v + 1);
+			if (y + 1 < height) add_edge(&workload->list, v, v + width);
+			// With one diagonal x + 2y mod 3 is a coloring, both diagonals make a K4
+			if (x + 1 < width && y + 1 < height) {
+				add_edge(&workload->list, v + 1, v + width);
+				if (rng_double(rng) < both) add_edge(&workload->list, v, v + width + 1);
+			}
+		}
+	}
+}
+
+void make_k4_dense(Workload *workload, Rng *rng, int k4s, int extra) {
+	snprintf(workload->name, sizeof(workload->name), "k4 x%d +%d", k4s, extra);
+	for (int k = 0; k < k4s; k++) {
+		for (int i = 0; i < 4; i++) {
+			for (int j = i + 1; j < 4; j++)
+				add_edge(&workload->list, 4 * k + i, 4 * k + j);
+		}
+	}
+	for (int i = 0; i < extra; i++) {
+		int u = rng_next(rng) % (4 * k4s), v = rng_next(rng) % (4 * k4s);
+		if (u / 4 != v / 4) add_edge(&workload->list, u, v);
+	}
+}
+
+/**
+ * @brief Reads a graph in DIMACS edge format, comments and the problem line are skipped
+ *
+ * @return false if the file can't be read or an edge line is malformed
+ */
+bool load_dimacs(Workload *workload, const char *path) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) return false;
+	snprintf(workload->name, sizeof(workload->name), "dimacs %s", path);
+
+	char line[BENCH_LINE_LEN];
+	bool res = true;
+	while (res && fgets(line, sizeof(line), file) != NULL) {
+		if (line[0] != 'e') continue;
+		int u, v;
+		res = sscanf(line + 1, "%d %d", &u, &v) == 2 && u > 0 && v > 0;
+		if (res) add_edge(&workload->list, u - 1, v - 1);
+	}
+	fclose(file);
+	return res && workload->list.count > 0;
+}
+
+void bench_random(const Reduction *reduction, Rng *rng, BenchResult *result) {
+	const EdgeList *core = &reduction->core;
+	ColoringBatch batch;
+	if (!coloring_batch_init(&batch, core->node_count)) handle_error("Failed to allocate batch.");
+	Solution solution = {0};
+	double start = now();
+
+	do {
+		for (int i = 0; i < 64; i++) {
+			random_coloring_batch(rng, &batch);
+			bool fits = true;
+			solution.count = 0;
+			for (int c = 0; c < reduction->component_count && fits; c++) {
+				const Edge *edges = core->edges + reduction->component_edges[c];
+				size_t count = reduction->component_edges[c+1] - reduction->component_edges[c];
+				int lane;
+				fits = score_coloring_batch(edges, count, &batch, &lane) != 0 \
+					&& collect_lane_conflicts(edges, count, &batch, lane, &solution);
+			}
+			result->steps += BATCH_LANES;
+			long edges = solution.count + reduction->loops.count;
+			if (fits && edges <= MAX_SOLUTION_EDGES && (result->best == -1 || edges < result->best)) {
+				result->best = edges;
+				result->time_to_best = now() - start;
+			}
+		}
+	} while (result->best != 0 && now() - start < budget);
+	result->seconds = now() - start;
+	coloring_batch_free(&batch);
+}
+
+void bench_tabu(const Reduction *reduction, Rng *rng, BenchResult *result) {
+	Graph graph;
+	TabuSearch search;
+	if (!create_graph(&graph, &reduction->core) || !tabu_init(&search, &graph, rng))
+		handle_error("Failed to allocate tabu search.");
+	double start = now();
+	result->best = search.best + reduction->loops.count;
+
+	while (search.state.total > 0 && now() - start < budget) {
+		for (int i = 0; i < 4096 && search.state.total > 0; i++) {
+			if (tabu_step(&search)) {
+				result->best = search.best + reduction->loops.count;
+				result->time_to_best = now() - start;
+			}
+		}
+	}
+	result->steps = search.iteration;
+	result->seconds = now() - start;
+	tabu_free(&search);
+	free_graph(&graph);
+}
+
+/* Skipped (false) if a component doesn't fit into bit rows */
+bool bench_exact(const Reduction *reduction, BenchResult *result) {
+	for (int c = 0; c < reduction->component_count; c++) {
+		if (reduction->component_nodes[c+1] - reduction->component_nodes[c] > BIT_GRAPH_SIZE)
+			return false;
+	}
+
+	double start = now();
+	result->best = reduction->loops.count;
+	result->proven = true;
+	for (int c = 0; c < reduction->component_count; c++) {
+		int first = reduction->component_nodes[c];
+		BitGraph bits;
+		ExactSearch search;
+		create_bit_graph_from_edges(&bits, reduction->core.edges + reduction->component_edges[c],
+			reduction->component_edges[c+1] - reduction->component_edges[c], first,
+			reduction->component_nodes[c+1] - first);
+		result->proven &= exact_solve(&search, &bits, EXACT_NODE_LIMIT);
+		result->best += search.best;
+		result->steps += search.nodes;
+	}
+	result->seconds = result->time_to_best = now() - start;
+	return true;
+}
+
+/* Like the generators, every mode only reports results a generator would write, more
+   than MAX_SOLUTION_EDGES edges count as nothing found */
+void print_result(const char *mode, const BenchResult *result) {
+	printf("  %-7s %12.0f/s  best ", mode, result->steps / (result->seconds > 0 ? result->seconds : 1e-9));
+	if (result->best == -1 || result->best > MAX_SOLUTION_EDGES)
+		printf("   >%d\n", MAX_SOLUTION_EDGES);
+	else
+		printf("%5ld  after %8.4fs%s\n", result->best, result->time_to_best, result->proven ? "  (optimal)" : "");
+}
+
+void run_workload(Workload *workload, uint64_t seed) {
+	Reduction reduction;
+	if (!reduce_graph(&reduction, &workload->list)) handle_error("Failed to reduce graph.");
+	int largest = 0;
+	for (int c = 0; c < reduction.component_count; c++) {
+		int size = reduction.component_nodes[c+1] - reduction.component_nodes[c];
+		if (size > largest) largest = size;
+	}
+	printf("%s: %d nodes, %zu edges, core %d nodes in %d components (largest %d)\n", workload->name,
+		workload->list.node_count, workload->list.count, reduction.core.node_count,
+		reduction.component_count, largest);
+
+	Rng rng;
+	BenchResult result = {.best = -1};
+	rng_seed(&rng, seed);
+	bench_random(&reduction, &rng, &result);
+	print_result("random", &result);
+
+	result = (BenchResult) {.best = -1};
+	rng_seed(&rng, seed);
+	bench_tabu(&reduction, &rng, &result);
+	print_result("tabu", &result);
+
+	result = (BenchResult) {.best = -1};
+	if (bench_exact(&reduction, &result))
+		print_result("exact", &result);
+	else
+		printf("  %-7s skipped, a component has more than %d nodes\n", "exact", BIT_GRAPH_SIZE);
+	free_reduction(&reduction);
+}
+
+/* Producer side of the supervisor protocol: wait free, publish, post used */
+void *ring_producer(void *arg) {
+	RingBench *bench = arg;
+	Solution solution = {.count = MAX_SOLUTION_EDGES / 2};
+	for (unsigned long i = 0; i < bench->records; i++) {
+		while (sem_wait(&bench->free_slots) == -1) {
+			if (errno != EINTR) handle_error("Failed to wait for a free slot.");
+		}
+		solution.edges[0].u = i;
+		ring_publish(bench->shm, &solution);
+		sem_post(&bench->used_slots);
+	}
+	return NULL;
+}
+
+void bench_ring(int producers) {
+	RingBench bench;
+	bench.shm = malloc(sizeof(SharedMemory));
+	if (bench.shm == NULL) handle_error("Failed to allocate ring.");
+	ring_init(bench.shm);
+	if (sem_init(&bench.free_slots, 0, BUF_LEN) == -1 || sem_init(&bench.used_slots, 0, 0) == -1)
+		handle_error("Failed to create semaphores.");
+	bench.records = BENCH_RING_RECORDS / producers;
+
+	pthread_t threads[producers];
+	double start = now();
+	for (int i = 0; i < producers; i++) {
+		if ((errno = pthread_create(&threads[i], NULL, ring_producer, &bench)) != 0)
+			handle_error("Failed to create producer.");
+	}
+
+	Solution solution;
+	unsigned long total = bench.records * producers;
+	for (unsigned long i = 0; i < total; i++) {
+		while (sem_wait(&bench.used_slots) == -1) {
+			if (errno != EINTR) handle_error("Failed to wait for a solution.");
+		}
+		while (!ring_consume(bench.shm, &solution))
+			;
+		sem_post(&bench.free_slots);
+	}
+	double seconds = now() - start;
+	for (int i = 0; i < producers; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("ring: %d producer(s), %lu solutions of %d edges, %.0f solutions/s\n", producers, total,
+		MAX_SOLUTION_EDGES / 2, total / seconds);
+	sem_destroy(&bench.free_slots);
+	sem_destroy(&bench.used_slots);
+	free(bench.shm);
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t seed = 1;
+	int producers = 1;
+
+	int c;
+	while ((c = getopt(argc, argv, "t:s:p:")) != -1) {
+		switch (c) {
+			case 't':
+				budget = strtod(optarg, NULL);
+				if (budget <= 0) usage();
+				break;
+			case 's':
+				if (!is_string_numeric(optarg)) usage();
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'p':
+				if (!is_string_numeric(optarg)) usage();
+				producers = strtol(optarg, NULL, 10);
+				if (producers < 1 || producers > 64) usage();
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+
+	int count = 5 + argc - optind;
+	Workload *workloads = calloc(count, sizeof(Workload));
+	if (workloads == NULL) handle_error("Failed to allocate workloads.");
+
+	Rng rng;
+	rng_seed(&rng, seed);
+	make_gnp(&workloads[0], &rng, 60, 0.08);
+	make_gnp(&workloads[1], &rng, 1000, 0.0046);
+	make_grid(&workloads[2], &rng, 40, 40, 0.002);
+	make_k4_dense(&workloads[3], &rng, 6, 10);
+	make_k4_dense(&workloads[4], &rng, 250, 600);
+	for (int i = optind; i < argc; i++) {
+		if (!load_dimacs(&workloads[5 + i - optind], argv[i])) {
+			fprintf(stderr, "bench: can't read DIMACS graph %s\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("seed %lu, %.1fs per strategy\n", (unsigned long) seed, budget);
+	for (int i = 0; i < count; i++) {
+		run_workload(&workloads[i], seed);
+		edge_list_free(&workloads[i].list);
+	}
+	bench_ring(producers);
+	free(workloads);
+	return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file exact.c
+ *
+ * @brief Exact search for the fewest edges whose removal makes a small graph 3-colorable
+ *
+ * @details Branch and bound over the bit rows of a BitGraph. Nodes are colored one at a time
+ *          in DSATUR order: the uncolored node that already sees the most different colors
+ *          among its neighbors comes first. A branch is cut when the conflicts so far plus a
+ *          lower bound for the rest can't beat the best coloring found. The bound adds for every
+ *          uncolored node the conflicts of its cheapest color with the colored nodes, and for
+ *          a set of disjoint cliques among the uncolored nodes the conflicts a clique can't
+ *          avoid. Both count different edges, so their sum is a valid bound. Colors are
+ *          interchangeable, a branch only opens the next unused color and never a later one.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "exact.h"
+#include <string.h>
+
+/* Fewest conflicting edges of a clique with size nodes, split as evenly as possible */
+static int clique_conflicts(int size) {
+	int q = size / 3, r = size % 3;
+	return r * (q + 1) * q / 2 + (3 - r) * q * (q - 1) / 2;
+}
+
+/**
+ * @brief Lower bound for the conflicting edges among nodes from greedy disjoint cliques
+ *
+ * @details Every clique grows from the lowest node left, adding the candidate with the
+ *          most neighbors among the other candidates. Cliques below 4 nodes add nothing.
+ */
+int exact_clique_bound(const BitGraph *graph, uint64_t nodes) {
+	int bound = 0;
+	while (nodes != 0) {
+		int v = __builtin_ctzll(nodes);
+		uint64_t clique = NODE_BIT(v);
+		uint64_t candidates = graph->adj[v] & nodes;
+		while (candidates != 0) {
+			int pick = -1, most = -1;
+			for (uint64_t left = candidates; left != 0; left &= left - 1) {
+				int w = __builtin_ctzll(left);
+				int count = __builtin_popcountll(graph->adj[w] & candidates);
+				if (count > most) {
+					most = count;
+					pick = w;
+				}
+			}
+			clique |= NODE_BIT(pick);
+			candidates &= graph->adj[pick];
+		}
+		nodes &= ~clique;
+		bound += clique_conflicts(__builtin_popcountll(clique));
+	}
+	return bound;
+}
+
+static void branch(ExactSearch *search, uint64_t uncolored, int cost, int used) {
+	const BitGraph *graph = search->graph;
+	if (++search->nodes > search->node_limit && search->node_limit != 0) {
+		search->proven = false;
+		return;
+	}
+	if (uncolored == 0) {
+		search->best = cost;
+		memcpy(search->best_colors, search->colors, sizeof(search->colors));
+		return;
+	}
+
+	// Bound and DSATUR pick in one pass, ties go to the higher forced cost, then the degree
+	int bound = cost, pick = -1;
+	long pick_key = -1;
+	for (uint64_t left = uncolored; left != 0; left &= left - 1) {
+		int v = __builtin_ctzll(left);
+		int saturation = 0, cheapest = BIT_GRAPH_SIZE;
+		for (int c = RED; c <= BLUE; c++) {
+			int seen = __builtin_popcountll(graph->adj[v] & search->classes[c]);
+			saturation += seen > 0;
+			if (seen < cheapest) cheapest = seen;
+		}
+		bound += cheapest;
+		long key = ((long) saturation << 16) | (cheapest << 8) | __builtin_popcountll(graph->adj[v] & uncolored);
+		if (key > pick_key) {
+			pick_key = key;
+			pick = v;
+		}
+	}
+	if (bound >= search->best) return;
+	if (bound + exact_clique_bound(graph, uncolored) >= search->best) return;
+
+	// Cheapest colors first, so good colorings are found early and cut more
+	int colors = used < BLUE ? used + 1 : BLUE;
+	int order[COLOR_SLOTS], added[COLOR_SLOTS];
+	for (int i = 0; i < colors; i++) {
+		int c = RED + i, j = i;
+		added[c] = __builtin_popcountll(graph->adj[pick] & search->classes[c]);
+		while (j > 0 && added[order[j-1]] > added[c]) {
+			order[j] = order[j-1];
+			j--;
+		}
+		order[j] = c;
+	}
+
+	uint64_t bit = NODE_BIT(pick);
+	for (int i = 0; i < colors && search->proven; i++) {
+		int c = order[i];
+		if (cost + added[c] >= search->best) break;
+		search->colors[pick] = c;
+		search->classes[c] |= bit;
+		branch(search, uncolored & ~bit, cost + added[c], c > used ? c : used);
+		search->classes[c] &= ~bit;
+	}
+	search->colors[pick] = NO_COLOR;
+}
+
+/**
+ * @brief Finds a coloring of graph with the fewest conflicting edges
+ *
+ * @param node_limit Branches to visit at most, 0 for no limit
+ * @return true if search->best is proven to be minimal, false if the search was stopped
+ *         early and search->best is only the best coloring it found
+ */
+bool exact_solve(ExactSearch *search, const BitGraph *graph, unsigned long node_limit) {
+	memset(search, 0, sizeof(*search));
+	search->graph = graph;
+	search->best = graph->size * BIT_GRAPH_SIZE; // more than any coloring can have
+	search->node_limit = node_limit;
+	search->proven = true;
+
+	uint64_t all = graph->size == BIT_GRAPH_SIZE ? ~0ULL : NODE_BIT(graph->size) - 1;
+	branch(search, all, 0, NO_COLOR);
+	debug("Exact search on %d nodes: %d conflicting edges after %lu branches%s", graph->size,
+		search->best, search->nodes, search->proven ? "" : " (stopped early)");
+	return search->proven;
+}
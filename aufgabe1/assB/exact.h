@@ -0,0 +1,30 @@
+#ifndef EXACT_H
+#define EXACT_H
+
+#include <stdbool.h>
+#include "header.h"
+
+#define EXACT_NODE_LIMIT 20000000UL /**< Branches the exact search may visit before giving up */
+
+/**
+ * @brief State of a branch and bound search for the fewest conflicting edges of a BitGraph
+ *
+ * @details classes and colors hold the partial coloring of the current branch, best and
+ *          best_colors the best complete coloring found so far. proven is cleared when the
+ *          search was stopped after node_limit branches.
+ */
+typedef struct {
+	const BitGraph *graph;
+	uint64_t classes[COLOR_SLOTS];
+	enum coloring colors[BIT_GRAPH_SIZE];
+	enum coloring best_colors[BIT_GRAPH_SIZE];
+	int best;
+	unsigned long nodes;
+	unsigned long node_limit;
+	bool proven;
+} ExactSearch;
+
+bool exact_solve(ExactSearch *search, const BitGraph *graph, unsigned long node_limit);
+int exact_clique_bound(const BitGraph *graph, uint64_t nodes);
+
+#endif
@@ -13,16 +13,51 @@
  *				 of 3 colors to each vertex of the graph
  *			\n\t Select all edges (u, v) for which the color u is identical to the color of v. These edges
  *				 need to be removed to make the graph 3-colorable.
+ *			\n\t Solutions with more than MAX_SOLUTION_EDGES edges are discarded, all others are
+ *				 written to the circular buffer as a compact Solution record.
+ *			\n The colorings are drawn and scored 64 at a time, bit-sliced so that one pass
+ *			over the edges checks an edge in all of them with a few word operations.
+ *			\n Before searching, nodes with less than 3 neighbors are peeled off the graph as
+ *			they never need an edge removed (see reduce.c). Only the remaining core is searched,
+ *			component by component, and solutions are renamed back to the input nodes.
+ *			\n With -s tabu the generator runs a local search instead: starting from a random
+ *			coloring it keeps recoloring conflicting vertices (see solver.c) and writes every
+ *			coloring that is better than all before it.
+ *			\n With -s exact every component of the core is solved by branch and bound (see
+ *			exact.c), which needs components of at most 64 nodes. The generator prints the
+ *			size of the optimal solution, writes it once marked as optimal, and terminates.
+ *			\n Between two batches the generator checks the epoch word of the shared memory and
+ *			stops once the supervisor changed it. A blocked write gives up after a short wait
+ *			to check it as well. The best solution that couldn't be written is written one
+ *			last time before the generator detaches, the supervisor keeps reading until then.
+ *			\n With -j the search runs in several threads of one process. They share the parsed
+ *			graph, but each has its own random number generator and best solution. A thread only
+ *			writes solutions with fewer edges than any solution the process wrote before, so
+ *			duplicates and solutions that can't help the supervisor never reach the buffer.
  *
  * @synopsis
- *		generator EDGE1 ...
- * @param EDGE1 One edge of a graph. At least one edge must be given. An edge is specified by a string,
- *				with the indices of the two nodes it connects separated by a - .
+ *		generator [-s random|tabu|exact] [-j threads] [-r seed] [-f file] EDGE1 ...
+ * @param -s    Strategy used to find solutions, random sampling (default), tabu search or
+ *				the exact search.
+ * @param -j    Number of search threads. Without it the search runs in the main thread and
+ *				writes every solution it finds. The exact search always runs in the main thread.
+ * @param -r    Seed of the random number generators, to repeat a run. Taken from the pid and
+ *				the time by default. supervisor -s and inspect print the seed of every generator.
+ * @param -f    Read further edges from file, separated by whitespace. With - as file the edges
+ *				are read from stdin.
+ * @param EDGE1 One edge of a graph. At least one edge must be given, either as argument or in the
+ *				file. An edge is specified by a string, with the indices of the two nodes it
+ *				connects separated by a - .
  *
  * @code
  * # Run the generator with a sample graph containing several edges
  * ./generator 0-1 0-2 0-3 1-2 1-3 2-3
  * # The edges here connect nodes in pairs (e.g. 0-1 connects node 0 and node 1)
+ * # Large graphs are better passed as a file or through stdin
+ * ./generator -f edges.txt
+ * # Four tabu searches over one copy of the graph
+ * ./generator -s tabu -j 4 -f edges.txt
+ * cat edges.txt | ./generator -f -
  * @endcode
  *
  * @author Volodymyr Skoryi
@@ -30,4 +65,477 @@
  *
  */
 
-int main(void) {}
+#include "generator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <semaphore.h>
+
+// Global vars for release_resources
+IpcChannel channel; // closed while all zero
+SharedMemory *shm = NULL;
+sem_t *free_sem = NULL, *used_sem = NULL; // the semaphores of channel
+int attached = 0; // generators registered in the shared memory, one per thread
+GeneratorStats *stats = NULL; // NULL if all stats slots were taken
+unsigned long epoch = 0; // of the supervisor at attach time
+volatile sig_atomic_t quit = 0;
+
+// Shared between the worker threads
+bool improvements_only = false;
+atomic_int process_best = MAX_SOLUTION_EDGES + 1;
+
+void release_resources(void);
+
+
+/**
+ * @brief Prints the usage message of the generator and exits with EXIT_FAILURE
+ */
+void usage(void) {
+	fprintf(stderr, "Usage: \n\t generator [-s random|tabu|exact] [-j threads] [-r seed] [-f file] EDGE1 ...\n");
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Outputs message and current error description. Terminates execution of program.
+ *
+ * @param msg Message to be displayed to stderr stream.
+ */
+void handle_error(const char *msg) {
+	fprintf(stderr, "generator: %s Details: %s\n", msg, strerror(errno));
+	release_resources();
+	exit(EXIT_FAILURE);
+}
+
+void handle_signal(int signal) {
+	quit = 1;
+}
+
+/**
+ * @brief Appends the edges of a file (or stdin if path is "-") to the edge list
+ *
+ * @return false if the file can't be read or contains an invalid edge
+ */
+bool load_edges(const char *path, EdgeList *list) {
+	if (strcmp(path, "-") == 0)
+		return read_edges_from_fd(STDIN_FILENO, list);
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) handle_error("Failed to open edge file.");
+	bool res = read_edges_from_fd(fd, list);
+	close(fd);
+	return res;
+}
+
+/* Counts an event in the stats slot of this process, callers check that it got one */
+static inline void count_stat(atomic_ulong *counter) {
+	atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief true once the generator was interrupted or the supervisor changed the epoch
+ */
+bool should_stop(void) {
+	return quit || atomic_load_explicit(&shm->epoch, memory_order_relaxed) != epoch;
+}
+
+/**
+ * @brief Writes one solution into the next free slot of the circular buffer
+ *
+ * @details A full buffer is waited on in slices of WAIT_SLICE_NS, so a generator notices
+ *          termination within one slice even if the supervisor stopped reading. The
+ *          last write of a worker passes a deadline instead and keeps waiting after
+ *          termination, the supervisor drains the buffer until all generators detached.
+ *
+ * @param deadline_ns CLOCK_MONOTONIC time to give up at, 0 to give up once should_stop()
+ * @return false if the solution was dropped
+ */
+bool write_solution(SharedMemory *shm, const Solution *solution, long long deadline_ns) {
+	if (sem_trywait(free_sem) == -1) {
+		if (errno == EAGAIN && stats != NULL) count_stat(&stats->full_waits);
+		TRACE_BEGIN(TRACE_INFO, "wait free slot");
+		while (true) {
+			long long slice = WAIT_SLICE_NS;
+			if (deadline_ns == 0 && should_stop()) {
+				TRACE_END(TRACE_INFO, "wait free slot");
+				return false;
+			}
+			if (deadline_ns != 0) {
+				slice = deadline_ns - monotonic_ns();
+				if (slice <= 0) {
+					TRACE_END(TRACE_INFO, "wait free slot");
+					return false;
+				}
+				if (slice > WAIT_SLICE_NS) slice = WAIT_SLICE_NS;
+			}
+
+			struct timespec until;
+			realtime_after(&until, slice);
+			if (sem_timedwait(free_sem, &until) == 0) break;
+			if (errno != EINTR && errno != ETIMEDOUT) handle_error("Failed to wait for a free slot.");
+		}
+		TRACE_END(TRACE_INFO, "wait free slot");
+	}
+
+	ring_publish(shm, solution);
+	TRACE(TRACE_INFO, "write solution", solution->count, solution->optimal);
+	if (sem_post(used_sem) == -1) handle_error("Failed to post a used slot.");
+	return true;
+}
+
+/**
+ * @brief Unmaps the shared memory and closes the semaphores, unlinking is left to the supervisor
+ */
+void release_resources(void) {
+	if (attached > 0) atomic_fetch_sub(&shm->generators, attached);
+	attached = 0;
+	if (stats != NULL) atomic_store(&stats->active, false);
+	stats = NULL;
+	shm = NULL;
+	free_sem = used_sem = NULL;
+	if (ipc_channel_close(&channel) == -1)
+		debug("Failed to close shared memory or semaphores. Error: %s", strerror(errno));
+}
+
+/**
+ * @brief Writes a solution of a worker, with -j only if it beats every solution written before
+ *
+ * @details A worker first compares against its own best, so threads stuck on a plateau
+ *          don't touch the best of the process at all. A solution any generator wrote
+ *          recently is dropped as a duplicate, the supervisor already has it.
+ */
+void offer_solution(Worker *worker, const Solution *solution) {
+	if (stats != NULL) count_stat(&stats->produced);
+	if (improvements_only) {
+		bool improves = solution->count < worker->best;
+		if (improves) {
+			worker->best = solution->count;
+			int best = atomic_load(&process_best);
+			do {
+				improves = solution->count < best;
+			} while (improves && !atomic_compare_exchange_weak(&process_best, &best, solution->count));
+		}
+		if (!improves) {
+			if (stats != NULL) count_stat(&stats->dropped);
+			return;
+		}
+	}
+
+	uint64_t fingerprint = solution_fingerprint(solution);
+	if (solution_seen(shm, fingerprint)) {
+		if (stats != NULL) {
+			count_stat(&stats->dropped);
+			count_stat(&stats->duplicates);
+		}
+		return;
+	}
+	if (write_solution(shm, solution, 0)) {
+		remember_solution(shm, fingerprint);
+		if (stats != NULL) count_stat(&stats->written);
+		if (solution->count <= worker->pending.count) worker->pending.count = MAX_SOLUTION_EDGES + 1;
+	} else {
+		if (stats != NULL) count_stat(&stats->dropped);
+		if (solution->count < worker->pending.count) worker->pending = *solution;
+	}
+}
+
+/**
+ * @brief Writes the best dropped solution of a worker, waiting at most FINAL_WRITE_NS for a slot
+ *
+ * @details With -j it is only written if no other thread wrote a better one meanwhile.
+ */
+void publish_pending(Worker *worker) {
+	if (worker->pending.count > MAX_SOLUTION_EDGES) return;
+	if (improvements_only && worker->pending.count > atomic_load(&process_best)) return;
+	if (write_solution(shm, &worker->pending, monotonic_ns() + FINAL_WRITE_NS)) {
+		debug("Worker %d wrote its last best solution with %d edges", worker->index, worker->pending.count);
+		if (stats != NULL) count_stat(&stats->written);
+	}
+	worker->pending.count = MAX_SOLUTION_EDGES + 1;
+}
+
+/**
+ * @brief Writes random colorings with at most MAX_SOLUTION_EDGES conflicts until termination
+ *
+ * @details The colorings are drawn and scored BATCH_LANES at a time. The components of
+ *          the core are independent, so every component takes the lane that is best on
+ *          its own edges and the solution is the union of those.
+ */
+void run_random_sampling(Worker *worker) {
+	const Reduction *reduction = worker->reduction;
+	const EdgeList *core = &reduction->core;
+	// Everything an attempt needs is allocated once up front
+	ColoringBatch batch;
+	if (!coloring_batch_init(&batch, core->node_count))
+		handle_error("Failed to allocate coloring buffer.");
+	Solution solution = {0};
+
+	while (!should_stop()) {
+		random_coloring_batch(&worker->rng, &batch);
+
+		bool fits = true;
+		solution.count = 0;
+		for (int c = 0; c < reduction->component_count && fits; c++) {
+			const Edge *edges = core->edges + reduction->component_edges[c];
+			size_t count = reduction->component_edges[c+1] - reduction->component_edges[c];
+			int lane;
+			fits = score_coloring_batch(edges, count, &batch, &lane) != 0 \
+				&& collect_lane_conflicts(edges, count, &batch, lane, &solution);
+		}
+		if (fits && restore_solution(reduction, &solution))
+			offer_solution(worker, &solution);
+	}
+	coloring_batch_free(&batch);
+}
+
+/**
+ * @brief Runs a tabu search on the core until termination and writes every improvement of it
+ *
+ * @details The search moves on after reaching a new best and usually ends a batch on a worse
+ *          coloring, so the conflicts of the best one are taken right when it is reached.
+ *          The best of a batch is written after the batch, or with the final write of the
+ *          worker if the generator has to stop meanwhile.
+ */
+void run_tabu_search(Worker *worker) {
+	Graph graph;
+	TabuSearch search;
+	if (!create_graph_view(&graph, worker->graph)) handle_error("Failed to allocate colors.");
+	if (!tabu_init(&search, &graph, &worker->rng)) handle_error("Failed to allocate tabu search.");
+	Solution best;
+
+	bool improved = tabu_solution(&search, &best); // the random start is the first solution
+	while (!should_stop()) {
+		for (int i = 0; i < TABU_BATCH && search.state.total > 0; i++) {
+			if (tabu_step(&search) && tabu_solution(&search, &best))
+				improved = true;
+		}
+		if (should_stop()) break;
+
+		if (improved && restore_solution(worker->reduction, &best))
+			offer_solution(worker, &best);
+		improved = false;
+
+		// Nothing left to improve, the supervisor terminates after the 0 edge solution
+		if (search.state.total == 0) break;
+	}
+	// A best that wasn't offered before stopping goes out with publish_pending()
+	if (improved && restore_solution(worker->reduction, &best) && best.count < worker->pending.count)
+		worker->pending = best;
+	tabu_free(&search);
+	free_graph_view(&graph);
+}
+
+/**
+ * @brief Solves every component of the core exactly and writes the combined solution once
+ *
+ * @details The optimum of the graph is the sum of the optima of its components plus its self
+ *          loops. It is printed to stdout in any case, but only written if it fits a Solution.
+ */
+void run_exact_search(Worker *worker) {
+	const Reduction *reduction = worker->reduction;
+	const EdgeList *core = &reduction->core;
+	Solution solution = {0};
+	long total = reduction->loops.count;
+	bool proven = true;
+
+	for (int c = 0; c < reduction->component_count && !should_stop(); c++) {
+		int first = reduction->component_nodes[c];
+		int size = reduction->component_nodes[c+1] - first;
+		BitGraph bits;
+		ExactSearch search;
+		if (!create_bit_graph_from_edges(&bits, core->edges + reduction->component_edges[c],
+				reduction->component_edges[c+1] - reduction->component_edges[c], first, size))
+			handle_error("Component doesn't fit the exact search.");
+		proven &= exact_solve(&search, &bits, EXACT_NODE_LIMIT);
+		total += search.best;
+
+		// Every edge once, from its lower node
+		for (int v = 0; v < size; v++) {
+			for (uint64_t above = bits.adj[v] & ~(NODE_BIT(v) | (NODE_BIT(v) - 1)); above != 0; above &= above - 1) {
+				int w = __builtin_ctzll(above);
+				if (search.best_colors[w] != search.best_colors[v]) continue;
+				if (solution.count < MAX_SOLUTION_EDGES) {
+					solution.edges[solution.count].u = v + first;
+					solution.edges[solution.count].v = w + first;
+				}
+				solution.count++;
+			}
+		}
+	}
+	if (should_stop()) return;
+
+	printf("generator: %s solution removes %ld edges.\n", proven ? "an optimal" : "the best found", total);
+	fflush(stdout);
+	if (total > MAX_SOLUTION_EDGES || !restore_solution(reduction, &solution)) return;
+	solution.optimal = proven;
+	offer_solution(worker, &solution);
+}
+
+/**
+ * @brief Entry point of a worker thread, the main thread calls it directly without -j
+ */
+void *run_worker(void *arg) {
+	Worker *worker = arg;
+	debug("Worker %d generating solutions", worker->index);
+	if (worker->strategy == TABU_SEARCH)
+		run_tabu_search(worker);
+	else if (worker->strategy == EXACT_SEARCH)
+		run_exact_search(worker);
+	else
+		run_random_sampling(worker);
+	publish_pending(worker);
+	return NULL;
+}
+
+/**
+ * @brief Runs the workers in threads of their own and waits for all of them
+ *
+ * @details Workers never block longer than WAIT_SLICE_NS without checking quit and
+ *          the epoch, so a signal that only interrupted one of them stops all.
+ */
+void run_threads(Worker workers[], int threads) {
+	for (int i = 0; i < threads; i++) {
+		if ((errno = pthread_create(&workers[i].thread, NULL, run_worker, &workers[i])) != 0)
+			handle_error("Failed to create worker thread.");
+	}
+	for (int i = 0; i < threads; i++)
+		pthread_join(workers[i].thread, NULL);
+}
+
+
+int main(int argc, char *argv[]) {
+	EdgeList list = {0};
+	enum strategy strategy = RANDOM_SAMPLING;
+	int threads = 0;
+	bool seeded = false;
+	uint64_t seed = 0;
+
+	int c;
+	while ((c = getopt(argc, argv, "s:j:r:f:")) != -1) {
+		switch (c) {
+			case 's':
+				if (strcmp(optarg, "random") == 0)
+					strategy = RANDOM_SAMPLING;
+				else if (strcmp(optarg, "tabu") == 0)
+					strategy = TABU_SEARCH;
+				else if (strcmp(optarg, "exact") == 0)
+					strategy = EXACT_SEARCH;
+				else
+					usage();
+				break;
+			case 'j':
+				if (!is_string_numeric(optarg)) usage();
+				threads = strtol(optarg, NULL, 10);
+				if (threads < 1 || threads > MAX_THREADS) usage();
+				improvements_only = true;
+				break;
+			case 'r':
+				if (!is_string_numeric(optarg)) usage();
+				seed = strtoull(optarg, NULL, 10);
+				seeded = true;
+				break;
+			case 'f':
+				if (!load_edges(optarg, &list)) {
+					fprintf(stderr, "generator: invalid edges in %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+
+	for (int i = optind; i < argc; i++) {
+		if (!construct_edges_from_str(argv[i], &list)) {
+			debug("Invalid edge: %s", argv[i]);
+			usage();
+		}
+	}
+	if (list.count == 0) usage();
+	debug("Parsed %zu edges over %d nodes", list.count, list.node_count);
+
+	Reduction reduction;
+	if (!reduce_graph(&reduction, &list)) handle_error("Failed to reduce graph.");
+
+	if (strategy == EXACT_SEARCH) {
+		for (int c = 0; c < reduction.component_count; c++) {
+			int size = reduction.component_nodes[c+1] - reduction.component_nodes[c];
+			if (size > BIT_GRAPH_SIZE) {
+				fprintf(stderr, "generator: -s exact needs core components of at most %d nodes, " \
+					"one has %d\n", BIT_GRAPH_SIZE, size);
+				exit(EXIT_FAILURE);
+			}
+		}
+		threads = 0; // one search per component, nothing to share
+		improvements_only = false;
+	}
+
+	// Only the colors are per worker, the rows of the graph are built once
+	Graph graph = {0};
+	if (strategy == TABU_SEARCH && !create_graph(&graph, &reduction.core))
+		handle_error("Failed to create graph.");
+
+	int worker_count = threads > 0 ? threads : 1;
+	Worker *workers = calloc(worker_count, sizeof(Worker));
+	if (workers == NULL) handle_error("Failed to allocate workers.");
+
+	if (!seeded) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		seed = ((uint64_t) getpid() << 32) ^ (uint64_t) now.tv_nsec ^ (uint64_t) now.tv_sec;
+	}
+	debug("Seed %llu", (unsigned long long) seed);
+	for (int i = 0; i < worker_count; i++) {
+		workers[i].index = i;
+		workers[i].strategy = strategy;
+		workers[i].reduction = &reduction;
+		workers[i].graph = &graph;
+		workers[i].best = MAX_SOLUTION_EDGES + 1;
+		workers[i].pending.count = MAX_SOLUTION_EDGES + 1;
+		rng_seed(&workers[i].rng, seed + i); // seeding mixes the bits, neighboring seeds are fine
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	debug("Opening the ring channel %s", IPC_NAMESPACE);
+	if (ipc_channel_open(&channel, IPC_NAMESPACE, sizeof(SharedMemory), IPC_FLAGS) == -1)
+		handle_error("Failed to open shared memory, is the supervisor running?");
+	shm = IPC_CHANNEL_DATA(&channel, SharedMemory);
+	free_sem = channel.free.sem;
+	used_sem = channel.used.sem;
+	// The supervisor reads until every thread detached after its last write
+	atomic_fetch_add(&shm->generators, worker_count);
+	attached = worker_count;
+	epoch = atomic_load(&shm->epoch);
+	if (epoch & EPOCH_TERMINATE) {
+		fprintf(stderr, "generator: the supervisor is terminating\n");
+		release_resources();
+		exit(EXIT_FAILURE);
+	}
+	stats = claim_generator_stats(shm, getpid());
+	if (stats == NULL) debug("All %d stats slots are taken, running without", MAX_GENERATORS);
+	else atomic_store(&stats->seed, seed);
+
+	if (threads > 0) {
+		debug("Generating solutions in %d threads", threads);
+		run_threads(workers, threads);
+	} else {
+		run_worker(&workers[0]);
+	}
+
+	debug("Terminating");
+	release_resources();
+	free(workers);
+	free_graph(&graph);
+	free_reduction(&reduction);
+	edge_list_free(&list);
+	return 0;
+}
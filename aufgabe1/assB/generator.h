@@ -0,0 +1,48 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "header.h"
+#include "solver.h"
+#include "reduce.h"
+#include "exact.h"
+
+#define TABU_BATCH 4096 /**< Tabu moves between two checks of the termination flag */
+#define MAX_THREADS 256 /**< Upper bound for -j */
+#define WAIT_SLICE_NS 100000000LL /**< Longest wait for a free slot before the epoch is checked again */
+#define FINAL_WRITE_NS 500000000LL /**< How long the last best solution may wait for a free slot */
+
+enum strategy {RANDOM_SAMPLING, TABU_SEARCH, EXACT_SEARCH};
+
+/**
+ * @brief One search of the generator, run either by the main thread or by a thread of its own
+ *
+ * @details The reduced graph and the graph of its core are shared read-only between all
+ *          workers, everything else is owned by the worker. best is the fewest edges the
+ *          worker has written, pending a better solution whose write was dropped and
+ *          that is written once more when the worker stops.
+ */
+typedef struct {
+	pthread_t thread;
+	int index;
+	enum strategy strategy;
+	const Reduction *reduction;
+	const Graph *graph; // of the core, empty unless the strategy needs the adjacency of the nodes
+	Rng rng;
+	int best;
+	Solution pending; // count is MAX_SOLUTION_EDGES + 1 while there is none
+} Worker;
+
+bool load_edges(const char *path, EdgeList *list);
+bool should_stop(void);
+bool write_solution(SharedMemory *shm, const Solution *solution, long long deadline_ns);
+void offer_solution(Worker *worker, const Solution *solution);
+void run_random_sampling(Worker *worker);
+void run_tabu_search(Worker *worker);
+void run_exact_search(Worker *worker);
+void publish_pending(Worker *worker);
+void *run_worker(void *arg);
+
+#endif
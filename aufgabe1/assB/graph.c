@@ -3,117 +3,191 @@
 #include <stdlib.h> 
 #include <stdbool.h>
 #include <string.h>
-#include <math.h>
-
-void construct_edges_from_str(char *in_str,
-		enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]) {
-	if (strlen(in_str) < 3) {
-		debug("String is too small to contain single edge. Size: %d", (int) strlen(in_str));
-	}
-
-
-	int size = 0;
-	int end_id;
-	char node1[(int) log10(MAX_GRAPH_SIZE)+2];
-	int node1_num;
-
-	char node2[(int) log10(MAX_GRAPH_SIZE)+2];
-	int node2_num;
-
-	char *unique_nodes[MAX_GRAPH_SIZE] = {NULL};
-	void add_node_if_unique(char *node_to_add) {
-		int pos = (int) strtol(node_to_add, NULL, 10);
-		if (unique_nodes[pos] == NULL) {
-			size++;
-			unique_nodes[pos] = malloc(strlen(node_to_add) + 1);
-			if (unique_nodes[pos] != NULL)
-				strcpy(unique_nodes[pos], node_to_add);
-			else
-				debug("Memory allocation failed for unique_nodes[%d]", pos);
+#include <errno.h>
+#include <unistd.h>
+
+/* One character of input advances the parser, a number is accumulated
+   while its digits are read and an edge is appended at its terminating
+   whitespace. Nothing is copied or allocated besides the growing list */
+static inline bool edge_parser_step(EdgeParser *parser, char c, EdgeList *list) {
+	if (c >= '0' && c <= '9') {
+		parser->value = parser->value * 10 + (c - '0');
+		if (parser->value > MAX_NODE_ID) {
+			debug("Node on line %lu is too big", parser->line);
+			return false;
 		}
+		parser->digits++;
+	} else if (c == '-') {
+		if (parser->digits == 0 || parser->first != -1) {
+			debug("Misplaced - on line %lu", parser->line);
+			return false;
+		}
+		parser->first = parser->value;
+		parser->value = 0;
+		parser->digits = 0;
+	} else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+		if (parser->first != -1) {
+			if (parser->digits == 0) {
+				debug("Edge on line %lu misses its second node", parser->line);
+				return false;
+			}
+			if (!edge_list_append(list, (int) parser->first, (int) parser->value))
+				return false;
+		} else if (parser->digits != 0) {
+			debug("Node %ld on line %lu is not part of an edge", parser->value, parser->line);
+			return false;
+		}
+		parser->first = -1;
+		parser->value = 0;
+		parser->digits = 0;
+		if (c == '\n') parser->line++;
+	} else {
+		debug("Unexpected character '%c' on line %lu", c, parser->line);
+		return false;
 	}
+	return true;
+}
 
-	void free_unique_nodes() {
-		for (int i = 0; i < MAX_GRAPH_SIZE; i++)
-			free(unique_nodes[i]);
-	}
-
-	int space;
-	int i = 0;
-
-	char str[strlen(in_str) + 2];
-	str[0] = ' ';
-	for (int i = 0; i < strlen(in_str); i++)
-		str[i+1] = in_str[i];
-	str[strlen(in_str)+1] = '\0';
-
+void edge_parser_init(EdgeParser *parser) {
+	parser->first = -1;
+	parser->value = 0;
+	parser->digits = 0;
+	parser->line = 1;
+}
 
-	while (str[i] != '\0') {
-		if (str[i] == ' ') {
+bool edge_parser_feed(EdgeParser *parser, const char *buf, size_t len, EdgeList *list) {
+	for (size_t i = 0; i < len; i++) {
+		if (!edge_parser_step(parser, buf[i], list))
+			return false;
+	}
+	return true;
+}
 
-			int def = i;
-			for ( ; (def-i) < sizeof(node1); def++) {
-				if (str[def] == '-')
-					break;
-			}
+bool edge_parser_finish(EdgeParser *parser, EdgeList *list) {
+	return edge_parser_step(parser, ' ', list); // the last edge may end without whitespace
+}
 
-			strncpy(node1, str + (i+1), (def-i)-1);
-			node1[def-i-1] = '\0';
-			if (is_string_numeric(node1)) {
-				node1_num = (int) strtol(node1, NULL, 10);
-				add_node_if_unique(node1);
-			} else {
-				debug("First of nodes specified is not numeric! Node: %s", node1);
-				free_unique_nodes();
-				//free(str);
-				return;
-			}
+bool construct_edges_from_str(const char *str, EdgeList *list) {
+	EdgeParser parser;
+	edge_parser_init(&parser);
+	return edge_parser_feed(&parser, str, strlen(str), list) && edge_parser_finish(&parser, list);
+}
 
-			for (space = def; (space - def) < sizeof(node2); space++) {
-				if (str[space] == ' ' || str[space] == '\0')
-					break;
-			}
+bool read_edges_from_fd(int fd, EdgeList *list) {
+	char buf[EDGE_READ_SIZE];
+	EdgeParser parser;
+	edge_parser_init(&parser);
+
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof(buf))) != 0) {
+		if (len == -1) {
+			if (errno == EINTR) continue;
+			debug("Failed to read edges. Error: %s", strerror(errno));
+			return false;
+		}
+		if (!edge_parser_feed(&parser, buf, len, list))
+			return false;
+	}
+	return edge_parser_finish(&parser, list);
+}
 
-			strncpy(node2, str + (def+1), (space-def)-1);
-			node2[space-def-1] = '\0';
-			if (is_string_numeric(node2)) {
-				node2_num = (int) strtol(node2, NULL, 10);
-				add_node_if_unique(node2);
-			} else {
-				debug("Second of nodes specified is not numeric! Node: %s", node2);
-				free_unique_nodes();
-				//free(str);
-				return;
-			}
+static int compare_nodes(const void *a, const void *b) {
+	int x = *(const int *) a, y = *(const int *) b;
+	return (x > y) - (x < y);
+}
 
-			edges[node1_num][node2_num] = CONNECTED; edges[node2_num][node1_num] = CONNECTED;
-		}
-		i++;
+bool create_graph(Graph *graph, const EdgeList *list) {
+	memset(graph, 0, sizeof(*graph));
+	int size = list->node_count;
+
+	// Every edge appears in the rows of both of its nodes
+	graph->row_start = calloc(size + 1, sizeof(size_t));
+	graph->degree = calloc(size > 0 ? size : 1, sizeof(int));
+	graph->neighbors = malloc((2 * list->count > 0 ? 2 * list->count : 1) * sizeof(int));
+	graph->colors = malloc((size > 0 ? size : 1) * sizeof(enum coloring));
+	if (graph->row_start == NULL || graph->degree == NULL || graph->neighbors == NULL \
+			|| graph->colors == NULL) {
+		debug("Failed to allocate graph with %d nodes and %zu edges", size, list->count);
+		free_graph(graph);
+		return false;
 	}
 
+	for (size_t i = 0; i < list->count; i++) {
+		if (list->edges[i].u == list->edges[i].v) continue; // a self loop can't be colored
+		graph->degree[list->edges[i].u]++;
+		graph->degree[list->edges[i].v]++;
+	}
+	for (int i = 0; i < size; i++) {
+		graph->row_start[i+1] = graph->row_start[i] + graph->degree[i];
+		graph->degree[i] = 0;
+	}
+	for (size_t i = 0; i < list->count; i++) {
+		int u = list->edges[i].u, v = list->edges[i].v;
+		if (u == v) continue;
+		graph->neighbors[graph->row_start[u] + graph->degree[u]++] = v;
+		graph->neighbors[graph->row_start[v] + graph->degree[v]++] = u;
+	}
 
+	// Sorted rows allow binary search, duplicate edges collapse into one
 	for (int i = 0; i < size; i++) {
-		for (int j = 0; j < size; j++) {
-			if (edges[i][j] != CONNECTED && edges[i][j] == UNDEFINED)
-				edges[i][j] = NOT_CONNECTED;
+		int *row = graph->neighbors + graph->row_start[i];
+		qsort(row, graph->degree[i], sizeof(int), compare_nodes);
+		int unique = 0;
+		for (int j = 0; j < graph->degree[i]; j++) {
+			if (unique == 0 || row[unique-1] != row[j])
+				row[unique++] = row[j];
 		}
+		graph->degree[i] = unique;
+		graph->edge_count += unique;
+		graph->colors[i] = NO_COLOR;
 	}
+	graph->edge_count /= 2;
+	graph->size = size;
+	return true;
+}
 
-	free_unique_nodes();
+void free_graph(Graph *graph) {
+	free(graph->row_start);
+	free(graph->degree);
+	free(graph->neighbors);
+	free(graph->colors);
+	memset(graph, 0, sizeof(*graph));
 }
 
-void create_graph(Graph *graph, int size, enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]) {
-	if (size >= MAX_GRAPH_SIZE) {
-		debug("Graph that you want to create exceeds max graph size by %d", \
-			(size - MAX_GRAPH_SIZE + 1));
-		return;
+/* A view shares the rows of graph and only owns its colors, so several threads can color
+   one graph at once. Edges must not be removed from graph while views of it exist */
+bool create_graph_view(Graph *view, const Graph *graph) {
+	*view = *graph;
+	view->colors = malloc((graph->size > 0 ? graph->size : 1) * sizeof(enum coloring));
+	if (view->colors == NULL) {
+		debug("Failed to allocate colors of a view with %d nodes", graph->size);
+		memset(view, 0, sizeof(*view));
+		return false;
 	}
+	for (int i = 0; i < graph->size; i++)
+		view->colors[i] = NO_COLOR;
+	return true;
+}
 
-	memcpy(graph->edges, edges, MAX_GRAPH_SIZE * MAX_GRAPH_SIZE * sizeof(enum connection));
-	memcpy(graph->edges, edges, size * size * sizeof(enum connection));
-	for (int i = 0; i < size; i++)
-		(graph->colors)[i] = NO_COLOR;
-	graph->size = size;
+void free_graph_view(Graph *view) {
+	free(view->colors);
+	memset(view, 0, sizeof(*view));
+}
+
+/* Position of node2 in the row of node1, or -1 */
+static long find_neighbor(const Graph *graph, int node1, int node2) {
+	const int *row = graph->neighbors + graph->row_start[node1];
+	int lo = 0, hi = graph->degree[node1] - 1;
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (row[mid] == node2)
+			return mid;
+		else if (row[mid] < node2)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
 }
 
 bool nodes_connected(const Graph *graph, int node1, int node2) { // const is a good practice if graph isn't changed
@@ -129,17 +203,14 @@ bool nodes_connected(const Graph *graph, int node1, int node2) { // const is a g
 		return false;
 	}
 
-	if ((graph->edges)[node1][node2] == CONNECTED && (graph->edges)[node1][node2] == CONNECTED)
-		return true;
-	else
-		return false;
+	return find_neighbor(graph, node1, node2) != -1;
 }
 
 void assign_color_to_node(Graph *graph, int node, enum coloring color) {
 	if (graph == NULL) {
 		debug("Null pointer received");
 		return;
-	} else if (node >= graph->size - 1) {
+	} else if (node < 0 || node >= graph->size) {
 		debug("Node to color exceeds graph size");
 		return;
 	} else if ((graph->colors)[node] == RED || (graph->colors)[node] == GREEN \
@@ -167,19 +238,127 @@ void get_adjacent_nodes_of_similar_color(Graph *graph, int node, int to_return[]
 		return;
 	}
 
-	for (int i = 0; i < graph->size; i++) {
-		if (graph->edges[node][i] == CONNECTED) {
-			if (graph->colors[node] == graph->colors[i]) {
-				to_return[*found_count] = i;
-				(*found_count)++;
-			} else {
-				// debug("Node %d is connected with node %d, but they are not of the similar color", node, i);
-				// debug("Node %d color: %d, node %d color: %d", node, graph->colors[node], i, graph->colors[i]);
-			}
+	const int *row = graph->neighbors + graph->row_start[node];
+	for (int i = 0; i < graph->degree[node]; i++) {
+		if (graph->colors[row[i]] == graph->colors[node]) {
+			to_return[*found_count] = row[i];
+			(*found_count)++;
 		}
 	}
 }
 
+int count_same_color_neighbors(const Graph *graph, int node) {
+	enum coloring color = graph->colors[node];
+	if (color == NO_COLOR)
+		return 0;
+
+	int count = 0;
+	const int *row = graph->neighbors + graph->row_start[node];
+	for (int i = 0; i < graph->degree[node]; i++)
+		count += graph->colors[row[i]] == color;
+	return count;
+}
+
+long count_conflicts(const Graph *graph) {
+	long count = 0;
+	for (int i = 0; i < graph->size; i++)
+		count += count_same_color_neighbors(graph, i);
+	return count / 2; // every conflicting edge was counted from both of its nodes
+}
+
+static inline void conflicting_add(ColoringState *state, int node) {
+	if (state->position[node] != -1) return;
+	state->position[node] = state->conflicting_count;
+	state->conflicting[state->conflicting_count++] = node;
+}
+
+static inline void conflicting_remove(ColoringState *state, int node) {
+	int pos = state->position[node];
+	if (pos == -1) return;
+	int last = state->conflicting[--state->conflicting_count];
+	state->conflicting[pos] = last;
+	state->position[last] = pos;
+	state->position[node] = -1;
+}
+
+/* A node is in the conflicting set while a neighbor shares its color */
+static inline void update_conflicting(ColoringState *state, int node) {
+	if (coloring_state_same(state, node) > 0)
+		conflicting_add(state, node);
+	else
+		conflicting_remove(state, node);
+}
+
+bool coloring_state_init(ColoringState *state, Graph *graph) {
+	memset(state, 0, sizeof(*state));
+	int size = graph->size > 0 ? graph->size : 1;
+	state->graph = graph;
+	state->counts = malloc(COLOR_SLOTS * size * sizeof(int));
+	state->conflicting = malloc(size * sizeof(int));
+	state->position = malloc(size * sizeof(int));
+	if (state->counts == NULL || state->conflicting == NULL || state->position == NULL) {
+		debug("Failed to allocate coloring state for %d nodes", graph->size);
+		coloring_state_free(state);
+		return false;
+	}
+
+	coloring_state_reset(state);
+	return true;
+}
+
+void coloring_state_reset(ColoringState *state) {
+	const Graph *graph = state->graph;
+	memset(state->counts, 0, COLOR_SLOTS * graph->size * sizeof(int));
+	state->conflicting_count = 0;
+	state->total = 0;
+	for (int v = 0; v < graph->size; v++) {
+		const int *row = graph->neighbors + graph->row_start[v];
+		for (int i = 0; i < graph->degree[v]; i++)
+			state->counts[COLOR_SLOTS * v + graph->colors[row[i]]]++;
+		state->total += coloring_state_same(state, v);
+		state->position[v] = -1;
+	}
+	state->total /= 2; // every conflicting edge was counted from both of its nodes
+	for (int v = 0; v < graph->size; v++)
+		update_conflicting(state, v);
+}
+
+void coloring_state_free(ColoringState *state) {
+	free(state->counts);
+	free(state->conflicting);
+	free(state->position);
+	memset(state, 0, sizeof(*state));
+}
+
+long recolor_node(ColoringState *state, int node, enum coloring color) {
+	Graph *graph = state->graph;
+	enum coloring old = graph->colors[node];
+	if (old == color)
+		return 0;
+
+	long delta = coloring_state_delta(state, node, color);
+	graph->colors[node] = color;
+	state->total += delta;
+
+	// Only the node and its neighbors see a different neighborhood
+	const int *row = graph->neighbors + graph->row_start[node];
+	for (int i = 0; i < graph->degree[node]; i++) {
+		int *counts = state->counts + COLOR_SLOTS * row[i];
+		counts[old]--;
+		counts[color]++;
+		update_conflicting(state, row[i]);
+	}
+	update_conflicting(state, node);
+	return delta;
+}
+
+/* Removes node2 from the row of node1, the row stays sorted and shrinks by one */
+static void remove_from_row(Graph *graph, int node1, int node2) {
+	long pos = find_neighbor(graph, node1, node2);
+	int *row = graph->neighbors + graph->row_start[node1];
+	memmove(row + pos, row + pos + 1, (graph->degree[node1] - pos - 1) * sizeof(int));
+	graph->degree[node1]--;
+}
 
 void remove_edge_between(Graph *graph, int node1, int node2) {
 	if (node1 >= graph->size || node2 >= graph-> size) {
@@ -188,29 +367,15 @@ void remove_edge_between(Graph *graph, int node1, int node2) {
 		return;
 	}
 
-	if (graph->edges[node1][node2] == UNDEFINED || graph->edges[node1][node2] == NOT_CONNECTED) {
-		debug("[REMOVE_EDGES_BETWEEN] Either connection between node1 and node2 is undefined or they are " \
-				"already DISCONNECTED. Connection: %d", graph->edges[node1][node2]);
+	if (!nodes_connected(graph, node1, node2)) {
+		debug("[REMOVE_EDGES_BETWEEN] Node %d and node %d are already DISCONNECTED", node1, node2);
 		return;
-	} else {
-		if (graph->edges[node1][node2] != graph->edges[node2][node1]) {
-			debug("[REMOVE_EDGES_BETWEEN] Connection between node1 and node2 is not symmetrical!!! Info: n1" \
-					"-n2 %d, n2-n1: %d", graph->edges[node1][node2], graph->edges[node2][node1]);
-			return;
-		} else {
-			if (graph->edges[node1][node2] == CONNECTED) { // sanity check
-				debug("[REMOVE_EDGES_BETWEEN] ALL good! Removing connection between node %d and node %d", node1, node2);
-				graph->edges[node1][node2] = NOT_CONNECTED;
-				graph->edges[node2][node1] = NOT_CONNECTED;
-				return;
-			} else {
-				debug("[REMOVE_EDGES_BETWEEN] SANITY CHECK FAILED!!!!! Something with this function is definately wrong");
-				return;
-			}
-		}
 	}
 
-	debug("[REMOVE_EDGES_BETWEEN] UNREACHABLE CODE!!! This line should not be executed!!!");
+	debug("[REMOVE_EDGES_BETWEEN] ALL good! Removing connection between node %d and node %d", node1, node2);
+	remove_from_row(graph, node1, node2);
+	remove_from_row(graph, node2, node1);
+	graph->edge_count--;
 }
 
 void print_adjacency_matrix(Graph *graph) {
@@ -232,23 +397,95 @@ void print_adjacency_matrix(Graph *graph) {
 	for (int i = 0; i < size; i++) {
 		printf("%d ", i);
 		for (int j = 0; j < size; j++) {
-			if (graph->edges[i][j] == 1)
-				fprintf(stdout, "O ");
-			else if (graph->edges[i][j] == 2)
+			if (find_neighbor(graph, i, j) != -1)
 				fprintf(stdout, "X ");
+			else
+				fprintf(stdout, "O ");
 		} printf("\n");
 	}
 
 }
 
-int define_graph_size_by_edges(enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]) {
-	int size = 0;
-	while (size < MAX_GRAPH_SIZE) {
-		if (edges[0][size] == UNDEFINED)
-			break;
-		size++;
+bool create_bit_graph(BitGraph *bits, const Graph *graph) {
+	if (graph->size > BIT_GRAPH_SIZE) {
+		debug("Graph with %d nodes doesn't fit into %d bit rows", graph->size, BIT_GRAPH_SIZE);
+		return false;
+	}
+
+	memset(bits, 0, sizeof(*bits));
+	for (int i = 0; i < graph->size; i++) {
+		const int *row = graph->neighbors + graph->row_start[i];
+		for (int j = 0; j < graph->degree[i]; j++)
+			bits->adj[i] |= NODE_BIT(row[j]);
+		bits->colors[i] = graph->colors[i];
+		bits->classes[graph->colors[i]] |= NODE_BIT(i);
+	}
+	bits->size = graph->size;
+	return true;
+}
+
+/* The nodes first .. first + size - 1 of the edges become nodes 0 .. size - 1, all nodes
+   are uncolored. Meant for a component of a Reduction, whose edges stay within its nodes */
+bool create_bit_graph_from_edges(BitGraph *bits, const Edge edges[], size_t count, int first, int size) {
+	if (size > BIT_GRAPH_SIZE) {
+		debug("Graph with %d nodes doesn't fit into %d bit rows", size, BIT_GRAPH_SIZE);
+		return false;
+	}
+
+	memset(bits, 0, sizeof(*bits));
+	for (size_t i = 0; i < count; i++) {
+		int u = edges[i].u - first, v = edges[i].v - first;
+		if (u < 0 || v < 0 || u >= size || v >= size || u == v) {
+			debug("Edge %d-%d is outside of nodes %d to %d", edges[i].u, edges[i].v, first, first + size - 1);
+			return false;
+		}
+		bits->adj[u] |= NODE_BIT(v);
+		bits->adj[v] |= NODE_BIT(u);
 	}
-	return size;
+	bits->classes[NO_COLOR] = size == BIT_GRAPH_SIZE ? ~0ULL : NODE_BIT(size) - 1;
+	bits->size = size;
+	return true;
+}
+
+int bit_graph_count_conflicts(const BitGraph *bits) {
+	int count = 0;
+	for (int i = 0; i < bits->size; i++) {
+		if (bits->colors[i] != NO_COLOR)
+			count += __builtin_popcountll(bits->adj[i] & bits->classes[bits->colors[i]]);
+	}
+	return count / 2;
+}
+
+bool edge_list_append(EdgeList *list, int u, int v) {
+	if (u < 0 || v < 0 || u > MAX_NODE_ID || v > MAX_NODE_ID) {
+		debug("Node out of range in edge %d-%d", u, v);
+		return false;
+	}
+
+	if (list->count == list->capacity) {
+		size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+		Edge *edges = realloc(list->edges, capacity * sizeof(Edge));
+		if (edges == NULL) {
+			debug("Failed to grow edge list to %zu edges", capacity);
+			return false;
+		}
+		list->edges = edges;
+		list->capacity = capacity;
+	}
+
+	list->edges[list->count].u = u;
+	list->edges[list->count].v = v;
+	list->count++;
+	if (u >= list->node_count) list->node_count = u + 1;
+	if (v >= list->node_count) list->node_count = v + 1;
+	return true;
+}
+
+void edge_list_free(EdgeList *list) {
+	free(list->edges);
+	list->edges = NULL;
+	list->count = list->capacity = 0;
+	list->node_count = 0;
 }
 
 
@@ -256,15 +493,18 @@ int define_graph_size_by_edges(enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_S
 void test_graph(char *str) {
 	printf("Input graph: %s\n", str);
 
-	enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
-	construct_edges_from_str(str, edges);
-
-	int size = define_graph_size_by_edges(edges);
-
+	EdgeList list = {0};
+	if (!construct_edges_from_str(str, &list)) {
+		debug("Failed to parse edges");
+		return;
+	}
 
 	debug("Creating graph from edges provided by str %s", str);
 	Graph graph;
-	create_graph(&graph, size, edges);
+	if (!create_graph(&graph, &list)) {
+		edge_list_free(&list);
+		return;
+	}
 
 	print_adjacency_matrix(&graph);
 
@@ -284,15 +524,32 @@ void test_graph(char *str) {
 	} printf("\n");
 
 	debug("Getting adjacent nodes of similar colors to node 0");
-	int adjacent_nodes[MAX_GRAPH_SIZE - 1]; int found_amount = 0;
+	int adjacent_nodes[graph.size]; int found_amount = 0;
 	get_adjacent_nodes_of_similar_color(&graph, 0, adjacent_nodes, &found_amount);
 	debug("Found %d adjacent nodes of similar color:", found_amount);
 	for (int i = 0; i < found_amount; i++) {
 		printf("%d ", adjacent_nodes[i]);
 	} printf("\n");
 
+	debug("Conflicting edges: %ld", count_conflicts(&graph));
+	BitGraph bits;
+	if (create_bit_graph(&bits, &graph))
+		debug("Conflicting edges in bit rows: %d", bit_graph_count_conflicts(&bits));
+
+	ColoringState state;
+	if (coloring_state_init(&state, &graph)) {
+		debug("Tracked conflicting edges: %ld, conflicting nodes: %d", state.total, state.conflicting_count);
+		long delta = recolor_node(&state, 1, GREEN);
+		debug("Recoloring node 1 to GREEN changed conflicts by %ld to %ld (recount: %ld)", \
+			delta, state.total, count_conflicts(&graph));
+		coloring_state_free(&state);
+	}
+
 	remove_edge_between(&graph, 0, 1);
 	print_adjacency_matrix(&graph);
+
+	free_graph(&graph);
+	edge_list_free(&list);
 }
 
 int main(void) {
@@ -303,8 +560,8 @@ int main(void) {
 
 	debug("Testing first string");
 	test_graph(input_str1);
-//	debug("Testing second string");
-//	test_graph(input_str2);
+	debug("Testing second string");
+	test_graph(input_str2);
 
 	return 0;
 }
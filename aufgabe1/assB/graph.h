@@ -3,22 +3,90 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
-#define MAX_GRAPH_SIZE 64
+#define BIT_GRAPH_SIZE 64 // one bit per node in a uint64_t row
+#define NODE_BIT(node) (1ULL << (node))
+#define EDGE_READ_SIZE (64 * 1024) // bytes read per call when edges come from a file
+#define MAX_NODE_ID (INT32_MAX - 1) // node_count = id + 1 still has to fit an int
 
 enum coloring {NO_COLOR, RED, GREEN, BLUE};
-enum connection {UNDEFINED, NOT_CONNECTED, CONNECTED};
+#define COLOR_SLOTS (BLUE + 1)
 
 typedef struct {
-	enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
-	enum coloring colors[MAX_GRAPH_SIZE];
+	int u;
+	int v;
+} Edge;
+
+// Growable list of edges, node_count is the highest node index seen + 1
+typedef struct {
+	Edge *edges;
+	size_t count;
+	size_t capacity;
+	int node_count;
+} EdgeList;
+
+// State of the single pass "u-v u-v ..." parser between two chunks of input
+typedef struct {
+	long first;          // first node of the current edge, -1 before its '-'
+	long value;          // number read so far
+	int digits;
+	unsigned long line;  // for error messages
+} EdgeParser;
+
+/* Compressed sparse rows sized at runtime, the neighbors of node i are
+   neighbors[row_start[i] .. row_start[i] + degree[i]) in ascending order.
+   degree[i] shrinks when edges are removed, row_start never moves */
+typedef struct {
+	size_t *row_start;
+	int *degree;
+	int *neighbors;
+	enum coloring *colors;
+	size_t edge_count;
 	int size;
 } Graph;
 
-void construct_edges_from_str(char *str,
-		enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]);
+/* Conflict bookkeeping for the colors of a Graph. counts[COLOR_SLOTS * v + c] is the number of
+   neighbors of v with color c, so v has counts[COLOR_SLOTS * v + colors[v]] same-color neighbors
+   and recoloring it changes the conflicting edges by the difference of two counts. conflicting
+   holds the nodes with a same-color neighbor in any order, position[v] is the index of v in it
+   or -1. Uncolored nodes never conflict */
+typedef struct {
+	Graph *graph;
+	int *counts;
+	int *conflicting;
+	int *position;
+	int conflicting_count;
+	long total; // edges whose nodes share a color
+} ColoringState;
+
+/* Bit j of adj[i] is set if nodes i and j are connected, bit i of classes[c]
+   is set if node i has color c. Same-color neighbors of v are adj[v] & classes[colors[v]].
+   Only for graphs of up to BIT_GRAPH_SIZE nodes */
+typedef struct {
+	uint64_t adj[BIT_GRAPH_SIZE];
+	uint64_t classes[BLUE + 1];
+	enum coloring colors[BIT_GRAPH_SIZE];
+	int size;
+} BitGraph;
+
+void edge_parser_init(EdgeParser *parser);
+
+bool edge_parser_feed(EdgeParser *parser, const char *buf, size_t len, EdgeList *list);
+
+bool edge_parser_finish(EdgeParser *parser, EdgeList *list);
+
+bool construct_edges_from_str(const char *str, EdgeList *list);
+
+bool read_edges_from_fd(int fd, EdgeList *list);
 
-void create_graph(Graph *graph, int size, enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]);
+bool create_graph(Graph *graph, const EdgeList *list);
+
+void free_graph(Graph *graph);
+
+bool create_graph_view(Graph *view, const Graph *graph);
+
+void free_graph_view(Graph *view);
 
 bool nodes_connected(const Graph *graph, int node1, int node2);
 
@@ -27,11 +95,45 @@ void assign_color_to_node(Graph *graph, int node, enum coloring color);
 void get_adjacent_nodes_of_similar_color(Graph *graph, int node, int to_return[],
 	int *found_count);
 
+int count_same_color_neighbors(const Graph *graph, int node);
+
+long count_conflicts(const Graph *graph);
+
+bool coloring_state_init(ColoringState *state, Graph *graph);
+
+// Recounts everything after colors or edges of the graph were changed behind the state's back
+void coloring_state_reset(ColoringState *state);
+
+void coloring_state_free(ColoringState *state);
+
+// Recolors node in O(degree) and returns the change of the conflicting edges
+long recolor_node(ColoringState *state, int node, enum coloring color);
+
+static inline int coloring_state_same(const ColoringState *state, int node) {
+	enum coloring color = state->graph->colors[node];
+	return color == NO_COLOR ? 0 : state->counts[COLOR_SLOTS * node + color];
+}
+
+// Change of the conflicting edges if node was recolored to color, O(1)
+static inline long coloring_state_delta(const ColoringState *state, int node, enum coloring color) {
+	const int *counts = state->counts + COLOR_SLOTS * node;
+	int gained = color == NO_COLOR ? 0 : counts[color];
+	return gained - coloring_state_same(state, node);
+}
+
 void remove_edge_between(Graph *graph, int node1, int node2);
 
 // I don't really know why, but it won't print if graph itself is sent
 void print_adjacency_matrix(Graph *graph);
 
-int define_graph_size_by_edges(enum connection edges[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE]);
+bool create_bit_graph(BitGraph *bits, const Graph *graph);
+
+bool create_bit_graph_from_edges(BitGraph *bits, const Edge edges[], size_t count, int first, int size);
+
+int bit_graph_count_conflicts(const BitGraph *bits);
+
+bool edge_list_append(EdgeList *list, int u, int v);
+
+void edge_list_free(EdgeList *list);
 
 #endif
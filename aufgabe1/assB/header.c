@@ -2,6 +2,8 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
+#include <sched.h>
+#include <time.h>
 
 bool is_string_numeric(const char *str) {
 	if (*str == '\0')
@@ -15,3 +17,172 @@ bool is_string_numeric(const char *str) {
 
 	return true;
 }
+
+void ring_init(SharedMemory *shm) {
+	for (unsigned long i = 0; i < BUF_LEN; i++)
+		atomic_init(&shm->buf[i].seq, i);
+	atomic_init(&shm->wr_pos, 0);
+	shm->rd_pos = 0;
+	atomic_init(&shm->epoch, 0);
+	atomic_init(&shm->generators, 0);
+	for (int i = 0; i < SEEN_SLOTS; i++)
+		atomic_init(&shm->seen[i], 0);
+}
+
+long long monotonic_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Absolute CLOCK_REALTIME deadline ns from now, the clock sem_timedwait() measures against */
+void realtime_after(struct timespec *deadline, long long ns) {
+	clock_gettime(CLOCK_REALTIME, deadline);
+	ns += deadline->tv_nsec;
+	deadline->tv_sec += ns / 1000000000LL;
+	deadline->tv_nsec = ns % 1000000000LL;
+}
+
+void stats_init(SharedMemory *shm) {
+	memset(shm->generator_stats, 0, sizeof(shm->generator_stats));
+	atomic_init(&shm->supervisor_stats.consumed, 0);
+	atomic_init(&shm->supervisor_stats.best, MAX_SOLUTION_EDGES + 1);
+	atomic_init(&shm->supervisor_stats.started_ns, monotonic_ns());
+	atomic_init(&shm->supervisor_stats.improved_ns, 0);
+}
+
+/**
+ * @brief Takes a stats slot for a generator process and resets its counters
+ *
+ * @details Slots of generators that exited are reused, the first free one is taken with a
+ *          compare and swap so that generators starting at once can't take the same slot.
+ *
+ * @return the slot or NULL if all MAX_GENERATORS slots are taken
+ */
+GeneratorStats *claim_generator_stats(SharedMemory *shm, int pid) {
+	for (int i = 0; i < MAX_GENERATORS; i++) {
+		GeneratorStats *stats = &shm->generator_stats[i];
+		bool inactive = false;
+		if (!atomic_compare_exchange_strong(&stats->active, &inactive, true)) continue;
+
+		atomic_store_explicit(&stats->produced, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats->written, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats->dropped, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats->duplicates, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats->full_waits, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats->seed, 0, memory_order_relaxed);
+		atomic_store(&stats->pid, pid);
+		return stats;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Prints the supervisor counters and one line per active generator
+ */
+void print_stats(FILE *out, const char *prog, SharedMemory *shm) {
+	SupervisorStats *stats = &shm->supervisor_stats;
+	long long now = monotonic_ns();
+	double elapsed = (now - atomic_load(&stats->started_ns)) / 1e9;
+	unsigned long consumed = atomic_load_explicit(&stats->consumed, memory_order_relaxed);
+	unsigned long fill = atomic_load(&shm->wr_pos) - shm->rd_pos;
+
+	fprintf(out, "[%s] %.1fs: consumed %lu (%.0f/s), ring %lu/%d", prog, elapsed, consumed,
+		elapsed > 0 ? consumed / elapsed : 0, fill, BUF_LEN);
+	int best = atomic_load(&stats->best);
+	long long improved = atomic_load(&stats->improved_ns);
+	if (best <= MAX_SOLUTION_EDGES)
+		fprintf(out, ", best %d edges, improved %.1fs ago\n", best, (now - improved) / 1e9);
+	else
+		fprintf(out, ", no solution yet\n");
+
+	for (int i = 0; i < MAX_GENERATORS; i++) {
+		GeneratorStats *gen = &shm->generator_stats[i];
+		if (!atomic_load(&gen->active)) continue;
+		fprintf(out, "[%s]   generator %d (seed %llu): produced %lu, written %lu, dropped %lu " \
+			"(%lu duplicates), full waits %lu\n", prog, atomic_load(&gen->pid), atomic_load(&gen->seed),
+			atomic_load_explicit(&gen->produced, memory_order_relaxed),
+			atomic_load_explicit(&gen->written, memory_order_relaxed),
+			atomic_load_explicit(&gen->dropped, memory_order_relaxed),
+			atomic_load_explicit(&gen->duplicates, memory_order_relaxed),
+			atomic_load_explicit(&gen->full_waits, memory_order_relaxed));
+	}
+}
+
+/**
+ * @brief Writes a solution into the ring, the caller must own a free slot (waited on the free semaphore)
+ *
+ * @details Concurrent generators get distinct positions from one fetch-and-add and then copy
+ *          their solutions in parallel. The slot of a position is already released by the
+ *          supervisor once the free semaphore was passed, the loop only guards that ordering.
+ */
+void ring_publish(SharedMemory *shm, const Solution *solution) {
+	unsigned long pos = atomic_fetch_add_explicit(&shm->wr_pos, 1, memory_order_relaxed);
+	Slot *slot = &shm->buf[pos % BUF_LEN];
+
+	while (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos)
+		sched_yield();
+
+	slot->solution.count = solution->count;
+	slot->solution.optimal = solution->optimal;
+	memcpy(slot->solution.edges, solution->edges, solution->count * sizeof(Edge));
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Takes the next solution out of the ring, the caller must have waited on the used semaphore
+ *
+ * @details A generator that reserved an earlier position may still be copying while a later
+ *          one already posted the used semaphore, false is returned until it has published.
+ *
+ * @return false if the next solution is not published yet
+ */
+bool ring_consume(SharedMemory *shm, Solution *solution) {
+	Slot *slot = &shm->buf[shm->rd_pos % BUF_LEN];
+	if (atomic_load_explicit(&slot->seq, memory_order_acquire) != shm->rd_pos + 1)
+		return false;
+
+	solution->count = slot->solution.count;
+	solution->optimal = slot->solution.optimal;
+	memcpy(solution->edges, slot->solution.edges, solution->count * sizeof(Edge));
+	atomic_store_explicit(&slot->seq, shm->rd_pos + BUF_LEN, memory_order_release);
+	shm->rd_pos++;
+	return true;
+}
+
+// Finalizer of splitmix64, spreads every input bit over the whole word
+static uint64_t mix64(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/**
+ * @brief Hashes the set of edges of a solution, never 0
+ *
+ * @details Edges are hashed on their own and summed up, so neither the order of the edges
+ *          nor the order of the nodes of an edge changes the fingerprint. An optimal solution
+ *          hashes differently from the same edges without the mark.
+ */
+uint64_t solution_fingerprint(const Solution *solution) {
+	uint64_t hash = mix64((uint64_t) solution->count << 1 | solution->optimal);
+	for (int i = 0; i < solution->count; i++) {
+		uint32_t u = solution->edges[i].u, v = solution->edges[i].v;
+		hash += mix64(u < v ? (uint64_t) u << 32 | v : (uint64_t) v << 32 | u);
+	}
+	return hash != 0 ? hash : 1;
+}
+
+/**
+ * @brief true if a solution with this fingerprint was written recently
+ *
+ * @details Lookups and inserts are single relaxed atomics without a lock. Two generators
+ *          racing on the same solution may both write it, which only costs a slot.
+ */
+bool solution_seen(SharedMemory *shm, uint64_t fingerprint) {
+	return atomic_load_explicit(&shm->seen[fingerprint & (SEEN_SLOTS - 1)], memory_order_relaxed) == fingerprint;
+}
+
+void remember_solution(SharedMemory *shm, uint64_t fingerprint) {
+	atomic_store_explicit(&shm->seen[fingerprint & (SEEN_SLOTS - 1)], fingerprint, memory_order_relaxed);
+}
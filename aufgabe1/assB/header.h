@@ -3,26 +3,85 @@
 #define HEADER_H
 
 #include "graph.h"
+#include "ipc.h"
+#include "trace.h"
+#include <stdatomic.h>
+#include <time.h>
 
-#define BUF_LEN 1024
-#define SHARED_MEM_NAME "/shared_circ_buff"
-#define SEMAPHORE_FREE_NAME "/free_slots"
-#define SEMAPHORE_USED_NAME "/used_slots"
+#define BUF_LEN 1024 // must stay a power of two, positions wrap around at ULONG_MAX
+#define MAX_SOLUTION_EDGES 8 // solutions with more removed edges are never written
+#define IPC_NAMESPACE "3coloring" // the ring channel is /3coloring.shm, /3coloring.free and /3coloring.used
+#define IPC_FLAGS (IPC_PREFAULT | IPC_LOCK) // no page faults on the first pass over the ring
+#define MAX_GENERATORS 64 // generator processes with a stats slot, further ones run without
+#define EPOCH_TERMINATE 1UL // low bit of SharedMemory.epoch, set once the generators have to stop
+#define SEEN_SLOTS 4096 // must stay a power of two, fingerprints of recently written solutions
 
-#ifdef DEBUG
-	#define debug(fmt, ...) \
-		(void) fprintf(stderr, "[%s:%d] " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
-#else
-	#define debug(msg, ...)
-#endif
+// One record of the circular buffer, the edges a generator wants removed
+typedef struct {
+	int count;
+	bool optimal; // no solution with less edges exists, set by the exact search
+	Edge edges[MAX_SOLUTION_EDGES];
+} Solution;
+
+/* A slot is free for the writer of position p while seq == p and holds a
+   published solution while seq == p + 1 */
+typedef struct {
+	atomic_ulong seq;
+	Solution solution;
+} Slot;
+
+/* Counters of one generator process, written by its own threads only. Readers just
+   want a recent value, so everything is updated and read with relaxed atomics */
+typedef struct {
+	atomic_int pid;          // last owner, 0 if the slot was never used
+	atomic_bool active;
+	atomic_ullong seed;      // of the random number generators, -r seed repeats the run
+	atomic_ulong produced;   // solutions with at most MAX_SOLUTION_EDGES edges found
+	atomic_ulong written;
+	atomic_ulong dropped;    // produced but not written, filtered or cut off by termination
+	atomic_ulong duplicates; // dropped because the same solution was written before
+	atomic_ulong full_waits; // writes that found the buffer full and had to wait
+} GeneratorStats;
 
+/* Times are CLOCK_MONOTONIC nanoseconds, which all processes of a machine share */
 typedef struct {
-	Graph buf[BUF_LEN];
-	int wr_pos;
-	int rd_pos;
-	bool should_terminate;
+	atomic_ulong consumed;
+	atomic_int best;           // MAX_SOLUTION_EDGES + 1 until the first solution
+	atomic_llong started_ns;
+	atomic_llong improved_ns;  // time of the last new best, 0 if there was none yet
+} SupervisorStats;
+
+/* Multi-producer/single-consumer ring. Generators reserve positions with an
+   atomic increment of wr_pos instead of taking a write mutex, the free and
+   used semaphores only count slots so that both sides can block.
+   seen is a direct-mapped table of solution fingerprints, slot fingerprint % SEEN_SLOTS
+   holds the last one written there and 0 while empty. A newer solution evicts an
+   older one, so only recent duplicates are caught */
+typedef struct {
+	Slot buf[BUF_LEN];
+	atomic_ulong wr_pos;
+	unsigned long rd_pos; // only touched by the supervisor
+	atomic_ulong epoch;    // run number << 1 | EPOCH_TERMINATE, generators stop once it changes
+	atomic_int generators; // attached generators, the supervisor drains the ring until they left
+	atomic_ullong seen[SEEN_SLOTS];
+	GeneratorStats generator_stats[MAX_GENERATORS];
+	SupervisorStats supervisor_stats;
 } SharedMemory;
 
 bool is_string_numeric(const char *str);
 
+long long monotonic_ns(void);
+void realtime_after(struct timespec *deadline, long long ns);
+
+void ring_init(SharedMemory *shm);
+void stats_init(SharedMemory *shm);
+GeneratorStats *claim_generator_stats(SharedMemory *shm, int pid);
+void print_stats(FILE *out, const char *prog, SharedMemory *shm);
+void ring_publish(SharedMemory *shm, const Solution *solution);
+bool ring_consume(SharedMemory *shm, Solution *solution);
+
+uint64_t solution_fingerprint(const Solution *solution);
+bool solution_seen(SharedMemory *shm, uint64_t fingerprint);
+void remember_solution(SharedMemory *shm, uint64_t fingerprint);
+
 #endif
@@ -0,0 +1,66 @@
+/**
+ * @file inspect.c
+ *
+ * @brief Prints the counters of a running supervisor and its generators
+ *
+ * @details Attaches read-only to the shared memory of the supervisor, so it can't disturb
+ *          the circular buffer, and prints the same lines as supervisor -s. With -r the
+ *          lines are printed again every interval seconds until the supervisor is gone.
+ *
+ * @synopsis
+ *		inspect [-r interval]
+ * @param -r  Repeat every interval seconds.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "header.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+void usage(void) {
+	fprintf(stderr, "Usage: \n\t inspect [-r interval]\n");
+	exit(EXIT_FAILURE);
+}
+
+void handle_error(const char *msg) {
+	fprintf(stderr, "inspect: %s Details: %s\n", msg, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int interval = 0;
+
+	int c;
+	while ((c = getopt(argc, argv, "r:")) != -1) {
+		switch (c) {
+			case 'r':
+				if (!is_string_numeric(optarg)) usage();
+				interval = strtol(optarg, NULL, 10);
+				break;
+			case '?': usage();
+				break;
+		}
+	}
+
+	IpcSegment segment;
+	if (ipc_segment_open(&segment, IPC_NAMESPACE, "shm", sizeof(SharedMemory), IPC_READONLY) == -1)
+		handle_error("Failed to open shared memory, is the supervisor running?");
+	SharedMemory *shm = segment.addr;
+
+	print_stats(stdout, "inspect", shm);
+	// The mapping outlives an unlink, the segment is gone once its name is
+	while (interval > 0) {
+		sleep(interval);
+		if (!ipc_segment_exists(&segment)) break;
+		print_stats(stdout, "inspect", shm);
+		fflush(stdout);
+	}
+
+	ipc_segment_close(&segment);
+	return 0;
+}
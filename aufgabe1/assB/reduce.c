@@ -0,0 +1,207 @@
+/**
+ * @file reduce.c
+ *
+ * @brief Shrinks a graph to the part the search actually has to look at
+ *
+ * @details Node ids of the input can be sparse, so the nodes that are part of an edge are
+ *          first renumbered densely and nothing is allocated by the highest id.
+ *          A node with less than 3 neighbors can always take a color none of its neighbors
+ *          has, so removing it doesn't change the edges an optimal solution removes. Peeling
+ *          such nodes until none is left leaves the 3-core of the graph, which is split into
+ *          its connected components. Only the core is searched. A solution is the set of
+ *          removed edges, not a coloring, so a solution on the core is one on the whole graph
+ *          once its nodes are renamed back: in reverse removal order a peeled node has at most
+ *          2 neighbors colored and always finds a free color.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "reduce.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum peel_state {PRESENT, QUEUED, PEELED};
+
+static int compare_ids(const void *a, const void *b) {
+	int x = *(const int *) a, y = *(const int *) b;
+	return (x > y) - (x < y);
+}
+
+/* Renames the nodes of list to 0 .. compact->node_count - 1 in the order of their ids,
+   ids[i] is the input id of node i */
+static bool compact_nodes(const EdgeList *list, EdgeList *compact, int **ids) {
+	size_t n = 2 * list->count;
+	int *sorted = *ids = malloc((n > 0 ? n : 1) * sizeof(int));
+	if (sorted == NULL) return false;
+	for (size_t i = 0; i < list->count; i++) {
+		sorted[2 * i] = list->edges[i].u;
+		sorted[2 * i + 1] = list->edges[i].v;
+	}
+	qsort(sorted, n, sizeof(int), compare_ids);
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (count == 0 || sorted[count - 1] != sorted[i]) sorted[count++] = sorted[i];
+	}
+
+	for (size_t i = 0; i < list->count; i++) {
+		const int *u = bsearch(&list->edges[i].u, sorted, count, sizeof(int), compare_ids);
+		const int *v = bsearch(&list->edges[i].v, sorted, count, sizeof(int), compare_ids);
+		if (!edge_list_append(compact, u - sorted, v - sorted)) return false;
+	}
+	return true;
+}
+
+/* Numbers the core nodes component by component in BFS order, so the nodes and
+   edges of a component end up next to each other */
+static bool split_components(Reduction *reduction, const Graph *graph, const enum peel_state state[],
+		int label[], int queue[]) {
+	for (int v = 0; v < graph->size; v++)
+		label[v] = -1;
+
+	int next = 0;
+	for (int s = 0; s < graph->size; s++) {
+		if (state[s] != PRESENT || label[s] != -1) continue;
+
+		int c = reduction->component_count++;
+		reduction->component_nodes[c] = next;
+		reduction->component_edges[c] = reduction->core.count;
+
+		int head = 0, tail = 0;
+		queue[tail++] = s;
+		label[s] = next;
+		reduction->original[next++] = s;
+		while (head < tail) {
+			int u = queue[head++];
+			const int *row = graph->neighbors + graph->row_start[u];
+			for (int j = 0; j < graph->degree[u]; j++) {
+				int w = row[j];
+				if (state[w] != PRESENT) continue;
+				if (label[w] == -1) {
+					queue[tail++] = w;
+					label[w] = next;
+					reduction->original[next++] = w;
+				}
+				// Every edge is appended once, by its node with the smaller label
+				if (label[u] < label[w] && !edge_list_append(&reduction->core, label[u], label[w]))
+					return false;
+			}
+		}
+	}
+	reduction->component_nodes[reduction->component_count] = next;
+	reduction->component_edges[reduction->component_count] = reduction->core.count;
+	reduction->core.node_count = next;
+	return true;
+}
+
+/* Removes nodes of degree below PEEL_DEGREE until there are none, degree[v] counts the
+   neighbors that aren't peeled yet and only shrinks once v is queued */
+static void peel(Reduction *reduction, const Graph *graph, int degree[], enum peel_state state[],
+		int queue[]) {
+	int head = 0, tail = 0;
+	for (int v = 0; v < graph->size; v++) {
+		degree[v] = graph->degree[v];
+		state[v] = degree[v] < PEEL_DEGREE ? QUEUED : PRESENT;
+		if (state[v] == QUEUED) queue[tail++] = v;
+	}
+	while (head < tail) {
+		int v = queue[head++];
+		reduction->peeled_count++;
+		state[v] = PEELED;
+
+		const int *row = graph->neighbors + graph->row_start[v];
+		for (int j = 0; j < graph->degree[v]; j++) {
+			int w = row[j];
+			if (state[w] == PEELED) continue;
+			if (--degree[w] < PEEL_DEGREE && state[w] == PRESENT) {
+				state[w] = QUEUED;
+				queue[tail++] = w;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Peels all nodes of degree below PEEL_DEGREE and splits the rest into components
+ *
+ * @return false if an allocation failed
+ */
+bool reduce_graph(Reduction *reduction, const EdgeList *list) {
+	memset(reduction, 0, sizeof(*reduction));
+	EdgeList compact = {0};
+	int *ids = NULL;
+	Graph graph;
+	if (!compact_nodes(list, &compact, &ids) || !create_graph(&graph, &compact)) {
+		edge_list_free(&compact);
+		free(ids);
+		return false;
+	}
+	int n = compact.node_count;
+	reduction->node_count = n;
+	edge_list_free(&compact);
+
+	size_t size = n > 0 ? n : 1;
+	int *degree = malloc(size * sizeof(int));
+	enum peel_state *state = malloc(size * sizeof(enum peel_state));
+	int *label = malloc(size * sizeof(int));
+	int *queue = malloc(size * sizeof(int));
+	reduction->original = malloc(size * sizeof(int));
+	reduction->component_nodes = malloc((size + 1) * sizeof(int));
+	reduction->component_edges = malloc((size + 1) * sizeof(size_t));
+	bool res = degree != NULL && state != NULL && label != NULL && queue != NULL \
+		&& reduction->original != NULL \
+		&& reduction->component_nodes != NULL && reduction->component_edges != NULL;
+
+	// create_graph drops self loops, they stay conflicting under every coloring
+	for (size_t i = 0; res && i < list->count; i++) {
+		const Edge *edge = &list->edges[i];
+		if (edge->u == edge->v) res = edge_list_append(&reduction->loops, edge->u, edge->v);
+	}
+	if (res) {
+		peel(reduction, &graph, degree, state, queue);
+		res = split_components(reduction, &graph, state, label, queue);
+	}
+	for (int i = 0; res && i < reduction->core.node_count; i++)
+		reduction->original[i] = ids[reduction->original[i]];
+	debug("Peeled %d of %d nodes, the core has %d nodes and %zu edges in %d components",
+		reduction->peeled_count, n, reduction->core.node_count, reduction->core.count,
+		reduction->component_count);
+
+	free(degree);
+	free(state);
+	free(label);
+	free(queue);
+	free(ids);
+	free_graph(&graph);
+	if (!res) free_reduction(reduction);
+	return res;
+}
+
+void free_reduction(Reduction *reduction) {
+	edge_list_free(&reduction->core);
+	edge_list_free(&reduction->loops);
+	free(reduction->original);
+	free(reduction->component_nodes);
+	free(reduction->component_edges);
+	memset(reduction, 0, sizeof(*reduction));
+}
+
+/**
+ * @brief Turns a solution on the core into one on the input graph
+ *
+ * @details Renames the nodes back and adds the self loops of the input.
+ *
+ * @return false if the self loops don't fit into the solution anymore
+ */
+bool restore_solution(const Reduction *reduction, Solution *solution) {
+	if (solution->count + reduction->loops.count > MAX_SOLUTION_EDGES) return false;
+
+	for (int i = 0; i < solution->count; i++) {
+		solution->edges[i].u = reduction->original[solution->edges[i].u];
+		solution->edges[i].v = reduction->original[solution->edges[i].v];
+	}
+	for (size_t i = 0; i < reduction->loops.count; i++)
+		solution->edges[solution->count++] = reduction->loops.edges[i];
+	return true;
+}
+
@@ -0,0 +1,32 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stdbool.h>
+#include "header.h"
+
+#define PEEL_DEGREE 3 /**< Nodes with fewer neighbors always find a free color */
+
+/**
+ * @brief The core of a graph left after peeling, split into its connected components
+ *
+ * @details Core nodes are numbered 0 .. core.node_count - 1, the nodes of component c are
+ *          [component_nodes[c], component_nodes[c+1]) and its edges are
+ *          core.edges[component_edges[c] .. component_edges[c+1]). original[i] is the input
+ *          id of core node i.
+ */
+typedef struct {
+	EdgeList core;
+	EdgeList loops; // self loops of the input, every solution has to remove them
+	int *original;
+	int peeled_count;
+	int *component_nodes;
+	size_t *component_edges;
+	int component_count;
+	int node_count; // of the input that are part of an edge
+} Reduction;
+
+bool reduce_graph(Reduction *reduction, const EdgeList *list);
+void free_reduction(Reduction *reduction);
+bool restore_solution(const Reduction *reduction, Solution *solution);
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @file solver.c
+ *
+ * @brief Strategies the generator uses to find solutions
+ *
+ * @details Random sampling draws independent random 3-colorings and keeps the conflicting
+ *          edges of each, 64 colorings at a time in bit-sliced form. The tabu search
+ *          (TabuCol) starts from one random coloring and recolors conflicting nodes one at
+ *          a time, a ColoringState of the graph keeps the neighbor color counts up to date
+ *          so that a move costs O(degree) instead of a pass over all edges.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "solver.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Seeds the generator, splitmix64 spreads similar seeds (e.g. pids) over the whole state
+ */
+void rng_seed(Rng *rng, uint64_t seed) {
+	uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	rng->state = (z ^ (z >> 31)) | 1; // xorshift state must never be 0
+}
+
+/**
+ * @brief Next 64 random bits of a xorshift64* generator
+ */
+uint64_t rng_next(Rng *rng) {
+	uint64_t x = rng->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	rng->state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief Allocates the bitplanes of BATCH_LANES colorings of node_count nodes
+ *
+ * @return false if the allocation failed
+ */
+bool coloring_batch_init(ColoringBatch *batch, int node_count) {
+	batch->node_count = node_count;
+	batch->planes = calloc(2 * (node_count > 0 ? node_count : 1), sizeof(uint64_t));
+	return batch->planes != NULL;
+}
+
+void coloring_batch_free(ColoringBatch *batch) {
+	free(batch->planes);
+	batch->planes = NULL;
+	batch->node_count = 0;
+}
+
+/**
+ * @brief Draws BATCH_LANES independent random colorings
+ *
+ * @details Two random words give every lane one of the 4 codes (lo, hi), the lanes
+ *          that drew the unused code 11 draw again. Each of the 3 colors stays
+ *          exactly equally likely and a node costs 2.7 random words on average.
+ */
+void random_coloring_batch(Rng *rng, ColoringBatch *batch) {
+	for (int v = 0; v < batch->node_count; v++) {
+		uint64_t lo = 0, hi = 0, pending = ~0ULL;
+		while (pending != 0) {
+			uint64_t a = rng_next(rng), b = rng_next(rng);
+			lo |= pending & a & ~b;
+			hi |= pending & b & ~a;
+			pending &= a & b;
+		}
+		batch->planes[2 * v] = lo;
+		batch->planes[2 * v + 1] = hi;
+	}
+}
+
+/* Lanes in which the nodes of edge share their color */
+static inline uint64_t batch_conflicts(const ColoringBatch *batch, const Edge *edge) {
+	const uint64_t *u = batch->planes + 2 * edge->u, *v = batch->planes + 2 * edge->v;
+	return ~((u[0] ^ v[0]) | (u[1] ^ v[1]));
+}
+
+_Static_assert(MAX_SOLUTION_EDGES + 1 < 16, "the lane counters of score_coloring_batch have 4 bits");
+// All ones for the counter bits that are 0 in MAX_SOLUTION_EDGES + 1, they don't matter for the cutoff
+#define UNUSED_PLANE(bit) ((((MAX_SOLUTION_EDGES + 1) >> (bit)) & 1) ? 0ULL : ~0ULL)
+
+/**
+ * @brief Scores all colorings of a batch in one pass over the given edges
+ *
+ * @details Every lane has a 4 bit counter, stored as 4 bitplanes, so adding the conflict
+ *          mask of an edge to all 64 counters is a ripple carry over 4 words. A lane is
+ *          dropped once it reaches MAX_SOLUTION_EDGES + 1 conflicts, the pass ends early
+ *          when no lane is left. The lanes with the smallest counter are found from the
+ *          highest bitplane down, keeping those with a 0 bit whenever there are any.
+ *
+ * @param best_lane Set to a lane with the fewest conflicts, if any lane is left
+ * @return mask of the lanes with at most MAX_SOLUTION_EDGES conflicting edges
+ */
+uint64_t score_coloring_batch(const Edge edges[], size_t count, const ColoringBatch *batch, int *best_lane) {
+	uint64_t alive = ~0ULL;
+	uint64_t c[4] = {0};
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t carry = batch_conflicts(batch, &edges[i]) & alive;
+		c[0] ^= carry; carry &= ~c[0];
+		c[1] ^= carry; carry &= ~c[1];
+		c[2] ^= carry; carry &= ~c[2];
+		c[3] ^= carry;
+
+		/* Dropped lanes stop counting, so no counter gets past MAX_SOLUTION_EDGES + 1 and
+		   one that has all of its 1 bits is exactly there (c[3] & c[0] for 9 = 0b1001) */
+		alive &= ~((c[0] | UNUSED_PLANE(0)) & (c[1] | UNUSED_PLANE(1)) & (c[2] | UNUSED_PLANE(2)) \
+			& (c[3] | UNUSED_PLANE(3)));
+		if ((i & 63) == 63 && alive == 0) break;
+	}
+	if (alive == 0) return 0;
+
+	uint64_t best = alive;
+	for (int bit = 3; bit >= 0; bit--) {
+		if ((best & ~c[bit]) != 0) best &= ~c[bit];
+	}
+	*best_lane = __builtin_ctzll(best);
+	return alive;
+}
+
+/**
+ * @brief Appends the conflicting edges of one lane to solution
+ *
+ * @return false if they don't fit into the solution
+ */
+bool collect_lane_conflicts(const Edge edges[], size_t count, const ColoringBatch *batch, int lane,
+		Solution *solution) {
+	uint64_t bit = 1ULL << lane;
+	for (size_t i = 0; i < count; i++) {
+		if ((batch_conflicts(batch, &edges[i]) & bit) == 0) continue;
+		if (solution->count == MAX_SOLUTION_EDGES) return false;
+		solution->edges[solution->count++] = edges[i];
+	}
+	return true;
+}
+/**
+ * @brief Allocates the search state for graph and starts from a random coloring
+ *
+ * @return false if the allocation failed
+ */
+bool tabu_init(TabuSearch *search, Graph *graph, Rng *rng) {
+	memset(search, 0, sizeof(*search));
+	int size = graph->size > 0 ? graph->size : 1;
+	search->rng = rng;
+	search->tabu = malloc(COLOR_SLOTS * size * sizeof(unsigned long));
+	if (search->tabu == NULL || !coloring_state_init(&search->state, graph)) {
+		tabu_free(search);
+		return false;
+	}
+
+	tabu_restart(search);
+	return true;
+}
+
+void tabu_free(TabuSearch *search) {
+	free(search->tabu);
+	coloring_state_free(&search->state);
+	memset(search, 0, sizeof(*search));
+}
+
+/**
+ * @brief Throws the current coloring away and starts again from a random one
+ *
+ * @details The overall best value is kept, only colorings better than it are reported as
+ *          improvements. Aspiration and the restart criterion use the best of the current run.
+ */
+void tabu_restart(TabuSearch *search) {
+	Graph *graph = search->state.graph;
+	for (int v = 0; v < graph->size; v++)
+		graph->colors[v] = RED + (((rng_next(search->rng) & 0xffff) * 3) >> 16);
+	coloring_state_reset(&search->state);
+	memset(search->tabu, 0, COLOR_SLOTS * graph->size * sizeof(unsigned long));
+
+	long total = search->state.total;
+	if (search->restarts == 0 || total < search->best)
+		search->best = total;
+	search->run_best = total;
+	search->restarts++;
+	search->last_improvement = search->iteration;
+}
+
+/**
+ * @brief Makes the best non-tabu recoloring of a conflicting node
+ *
+ * @details Every conflicting node and color is a candidate move, the one that removes the most
+ *          conflicts (or adds the fewest) is taken even if it makes the coloring worse. The old
+ *          color of the node becomes tabu for it for a tenure that grows with the number of
+ *          conflicting nodes, unless taking it would beat the best coloring so far (aspiration).
+ *          Ties are broken randomly. After TABU_RESTART_AFTER iterations without improving the
+ *          current run the search restarts from a new random coloring.
+ *
+ * @return true if the move reached a coloring better than every one before
+ */
+bool tabu_step(TabuSearch *search) {
+	ColoringState *state = &search->state;
+	search->iteration++;
+	if (state->conflicting_count == 0)
+		return false;
+	if (search->iteration - search->last_improvement > TABU_RESTART_AFTER) {
+		tabu_restart(search);
+		return false;
+	}
+
+	int node = -1, ties = 0;
+	enum coloring color = NO_COLOR;
+	long best_delta = 0;
+	for (int i = 0; i < state->conflicting_count; i++) {
+		int v = state->conflicting[i];
+		const unsigned long *tabu = search->tabu + COLOR_SLOTS * v;
+		for (enum coloring c = RED; c <= BLUE; c++) {
+			if (c == state->graph->colors[v]) continue;
+			long delta = coloring_state_delta(state, v, c);
+			if (tabu[c] > search->iteration && state->total + delta >= search->run_best)
+				continue;
+			if (node == -1 || delta < best_delta) {
+				node = v;
+				color = c;
+				best_delta = delta;
+				ties = 1;
+			} else if (delta == best_delta && rng_next(search->rng) % ++ties == 0) {
+				node = v;
+				color = c;
+			}
+		}
+	}
+	if (node == -1) return false; // every move is tabu
+
+	search->tabu[COLOR_SLOTS * node + state->graph->colors[node]] = search->iteration + TABU_TENURE \
+		+ (unsigned long) (0.6 * state->conflicting_count) + rng_next(search->rng) % 10;
+	recolor_node(state, node, color);
+
+	if (state->total < search->run_best) {
+		search->run_best = state->total;
+		search->last_improvement = search->iteration;
+	}
+	if (state->total < search->best) {
+		search->best = state->total;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Collects the conflicting edges of the current coloring
+ *
+ * @return false if the coloring needs more than MAX_SOLUTION_EDGES removed edges
+ */
+bool tabu_solution(const TabuSearch *search, Solution *solution) {
+	const ColoringState *state = &search->state;
+	if (state->total > MAX_SOLUTION_EDGES) return false;
+
+	const Graph *graph = state->graph;
+	int count = 0;
+	for (int i = 0; i < state->conflicting_count; i++) {
+		int v = state->conflicting[i];
+		const int *row = graph->neighbors + graph->row_start[v];
+		for (int j = 0; j < graph->degree[v]; j++) {
+			int w = row[j];
+			if (w > v && graph->colors[w] == graph->colors[v]) {
+				solution->edges[count].u = v;
+				solution->edges[count].v = w;
+				count++;
+			}
+		}
+	}
+	solution->count = count;
+	solution->optimal = false;
+	return true;
+}
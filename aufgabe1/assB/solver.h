@@ -0,0 +1,63 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "header.h"
+
+#define BATCH_LANES 64 /**< Colorings scored together, one per bit of a word */
+#define TABU_TENURE 2 /**< Minimal iterations a node can't go back to its old color */
+#define TABU_RESTART_AFTER 100000 /**< Iterations without improvement before a random restart */
+
+/**
+ * @brief State of a xorshift64* pseudo random number generator, one per worker
+ */
+typedef struct {
+	uint64_t state;
+} Rng;
+
+/**
+ * @brief BATCH_LANES colorings in bit-sliced form
+ *
+ * @details planes[2 * v] and planes[2 * v + 1] are the low and high color bit of node v,
+ *          bit k of both belongs to coloring k. The colors are encoded as 00, 01 and 10.
+ */
+typedef struct {
+	uint64_t *planes;
+	int node_count;
+} ColoringBatch;
+
+/**
+ * @brief State of a tabu search on the colors of a Graph
+ *
+ * @details The ColoringState keeps the conflicting edges up to date with every move.
+ *          tabu[COLOR_SLOTS * v + c] is the iteration until which v may not take color c.
+ */
+typedef struct {
+	ColoringState state;
+	Rng *rng;
+	unsigned long *tabu;
+	long best;            // conflicting edges of the best coloring so far
+	long run_best;        // same, but only since the last restart
+	unsigned long iteration;
+	unsigned long last_improvement;
+	unsigned long restarts;
+} TabuSearch;
+
+void rng_seed(Rng *rng, uint64_t seed);
+uint64_t rng_next(Rng *rng);
+
+bool coloring_batch_init(ColoringBatch *batch, int node_count);
+void coloring_batch_free(ColoringBatch *batch);
+void random_coloring_batch(Rng *rng, ColoringBatch *batch);
+uint64_t score_coloring_batch(const Edge edges[], size_t count, const ColoringBatch *batch, int *best_lane);
+bool collect_lane_conflicts(const Edge edges[], size_t count, const ColoringBatch *batch, int lane,
+		Solution *solution);
+
+bool tabu_init(TabuSearch *search, Graph *graph, Rng *rng);
+void tabu_free(TabuSearch *search);
+void tabu_restart(TabuSearch *search);
+bool tabu_step(TabuSearch *search);
+bool tabu_solution(const TabuSearch *search, Solution *solution);
+
+#endif
@@ -1,27 +1,41 @@
 /**
  * @file supervisor.c
  *
- * @brief
+ * @brief Collect solutions of the generators and remember the best one
  *
- * @details
+ * @details The supervisor sets up the shared memory with the circular buffer and the
+ *          semaphores, waits delay seconds and then reads the solutions that the
+ *          generators write. Whenever a solution with less edges than the best so far
+ *          arrives it is printed to stderr. The supervisor stops after limit solutions,
+ *          on SIGINT/SIGTERM, when a solution with 0 edges shows that the graph is
+ *          3-colorable or when a solution is marked as optimal by an exact search. Then it
+ *          sets the terminate bit of the epoch word in the shared memory, which the
+ *          generators check between two batches, and keeps reading until all of them wrote
+ *          their last best solution and detached. Then it releases all resources.
+ *          With -c the best solution is saved to a checkpoint file after every
+ *          improvement and at exit. A supervisor started with the
+ *          same file resumes from the saved solution and only reports better ones.
+ *          The supervisor and every generator keep counters in the shared memory, with -s
+ *          they are printed to stderr periodically. inspect prints them from outside.
  *
  * @synopsis
- *		supervisor [-n limit] [-w delay]
+ *		supervisor [-n limit] [-w delay] [-s interval] [-c checkpoint]
  * @param -n  The argument limit specifies a limit (integer value) for the
  *			  number of generated solutions. If limit is omitted, it should
  * 			  be considered as infinite
  * @param -w  The argument delay specifies a delay (in seconds) before reading
  *			  the first solution from the buffer. If delay is omitted, it
  *		      should be considered as zero.
+ * @param -s  Print the counters of the supervisor and the generators every interval
+ *			  seconds.
+ * @param -c  Checkpoint file to resume from if it exists and to save the progress to.
  *
  * @author Volodymyr Skoryi
  * @date 08.11.2024
  */
 
-#include "header.h"
+#include "supervisor.h"
 #include <stdio.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <string.h>
@@ -31,39 +45,22 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <limits.h>
-
-/**
- * @def DEBUG
- * @brief Enables debug mode for detailed error messages
- * @details When this file is compiled with a -DDEBUG flag, 'debug' macto is going to print
- *          debug information to stderr stream including file name and line number. In case
- *          this flag was not specified, than debug outputs are not going to be printed
- * @param fmt The format string, similar to printf
- * @param ... Additional arguments to plug in the string
- */
-
-#ifdef DEBUG
-#define debug(fmt, ...) \
-	(void) fprintf(stderr, "[%s:%d] " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
-#else
-#define debug(msg, ...)
-#endif
-
-#define SHM_NAME "/supervisor_generator_shm"
-#define SEMAPHORE_NAME "/supervisor_generator_semaphore"
-#define MAX_DATA (4096)
-
-typedef struct {
-	unsigned int state;
-	unsigned int data[MAX_DATA];
-} shm_t;
-
-
-void handle_error(const char *msg);
-void terminate_generators(const char *message);
-int create_shared_memory(void);
-shm_t* map_shared_memory(int shmfd);
-void release_shared_memory(shm_t *shm);
+#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+
+// Global vars for terminate_generators and the cleanup
+IpcChannel channel; // closed while all zero
+SharedMemory *shm = NULL;
+sem_t *free_sem = NULL, *used_sem = NULL; // the semaphores of channel
+volatile sig_atomic_t quit = 0;
+const char *prog_name = "supervisor";
+const char *checkpoint_path = NULL; // NULL without -c
+Checkpoint progress = {0, {MAX_SOLUTION_EDGES + 1, false, {{0}}}};
+
+void handle_signal(int signal) {
+	quit = 1;
+}
 
 
 /**
@@ -77,20 +74,22 @@ void release_shared_memory(shm_t *shm);
  * @date   08.11.2024
  */
 void usage(void) {
-	fprintf(stderr, "Usage: \n\t supervisor [-n limit] [-w delay]\n");
+	fprintf(stderr, "Usage: \n\t supervisor [-n limit] [-w delay] [-s interval] [-c checkpoint]\n");
 	exit(EXIT_FAILURE);
 }
 
 
 int main(int argc, char* argv[]) {
 	debug("Program started, fetching args", NULL);
+	prog_name = argv[0];
 	unsigned long lim = 0; // if lim is 0 it is considered as infin
 	unsigned int delay = 0; // if 0 then 0
+	unsigned int interval = 0; // seconds between two stats lines, 0 for none
 
 	char *str = NULL; // temporary string for str -> int conversion
 
 	int c;
-	while ( (c = getopt(argc, argv, "n:w:")) != -1 ) {
+	while ( (c = getopt(argc, argv, "n:w:s:c:")) != -1 ) {
 		switch (c) {
 			case 'n':
 				str = optarg;
@@ -110,6 +109,13 @@ int main(int argc, char* argv[]) {
 					usage();
 				}
 				break;
+			case 's':
+				if (!is_string_numeric(optarg)) usage();
+				interval = strtol(optarg, NULL, 10);
+				break;
+			case 'c':
+				checkpoint_path = optarg;
+				break;
 			case '?': usage();
 				break;
 		}
@@ -121,118 +127,300 @@ int main(int argc, char* argv[]) {
 	}
 
 	debug("Arguments that will be used: limit - %lu, delay - %d", lim, delay);
+	if (checkpoint_path != NULL) load_checkpoint(checkpoint_path);
 
 	// Set up the shared memory and the semaphores
-	debug("Setting up the shared memory");
-	int shared_memory = create_shared_memory();
-	shm_t* memory_mapping = map_shared_memory(shared_memory);
-	debug("Setting up semaphores");
-
-	
-
-	
-	memory_mapping->data[0];
-
-		// Set up a variable, which is checked by generator processes (to terminate)
-	// Initialize the circular buffer required for the communication with the generators
-		// Keep reading until SIGINT/SIGTERM received or if [-n limit crossed]
-			// Notify generators to terminate
-			// Unlink all shared recources
-			// Print to stdout -> The graph might not be 3-colorable, best solution
-				// N edges. (N is replaced with the number of edges of the best solution)
-			// Exit
-	// Initialization complete -> wait for DELAY seconds and read solutions from circ buff
-		// Note: Use sleep() to give generators enough time to start
-	// Remember the best solution (e.g. solution with the least edges)
-		// When a beter solution -> write to stderr
-	// If generator writes solution with 0 edges to circ buff -> terminate
-		// Print to stdout -> The graph is 3-colorable!
-		// Exit
+	debug("Setting up the ring channel %s", IPC_NAMESPACE);
+	if (ipc_channel_create(&channel, IPC_NAMESPACE, sizeof(SharedMemory), BUF_LEN, IPC_FLAGS) == -1)
+		handle_error("Failed to create the shared memory and semaphores, is another supervisor running?");
+	shm = IPC_CHANNEL_DATA(&channel, SharedMemory);
+	free_sem = channel.free.sem;
+	used_sem = channel.used.sem;
+	ring_init(shm);
+	stats_init(shm);
+	atomic_store(&shm->epoch, progress.epoch << 1);
+	atomic_store(&shm->supervisor_stats.best, progress.best.count);
+	if (progress.best.count <= MAX_SOLUTION_EDGES)
+		atomic_store(&shm->supervisor_stats.improved_ns, monotonic_ns()); // resumed now
+
+	// No SA_RESTART, a signal has to interrupt the blocking sem_wait
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	// Give the generators time to start
+	if (delay > 0) {
+		debug("Waiting %u seconds before reading the first solution", delay);
+		unsigned int left = delay;
+		while (left > 0 && !quit)
+			left = sleep(left);
+	}
+
+	Solution solution;
+	unsigned long read = 0;
+	long long next_stats = monotonic_ns() + interval * 1000000000LL;
+	bool done = progress.best.count == 0 || progress.best.optimal; // nothing left to find
+	while (!done && !quit && read < lim) {
+		if (wait_for_solution(interval, &next_stats) == -1) {
+			if (errno == EINTR || errno == ETIMEDOUT) continue;
+			handle_error("Failed to wait for a solution.");
+		}
+		if (!take_solution(&solution)) break;
+		read++;
+		done = record_solution(&solution);
+	}
+	debug("Read %lu solutions", read);
+
+	terminate_generators(NULL);
+	drain_generators();
+	if (interval > 0) print_stats(stderr, prog_name, shm);
+	if (checkpoint_path != NULL) save_checkpoint(checkpoint_path);
+	release_resources();
+
+	int best = progress.best.count;
+	if (best == 0)
+		printf("The graph is 3-colorable!\n");
+	else if (progress.best.optimal)
+		printf("The graph is not 3-colorable, an optimal solution removes %d edges.\n", best);
+	else if (best <= MAX_SOLUTION_EDGES)
+		printf("The graph might not be 3-colorable, best solution removes %d edges.\n", best);
+	else
+		printf("The graph might not be 3-colorable, no solution with at most %d edges was found.\n",
+			MAX_SOLUTION_EDGES);
+
 	return 0;
 }
 
 
 /**
- * @brief Outputs message and current error description. Terminates execution of program.
+ * @brief Waits for a used slot, printing the stats whenever interval seconds have passed
  *
- * @param msg Message to be displayed to stderr stream.
+ * @return like sem_wait(), or -1 with errno ETIMEDOUT if the stats were due before a solution
  */
+int wait_for_solution(unsigned int interval, long long *next_stats) {
+	if (interval == 0) return sem_wait(used_sem);
 
-void handle_error(const char *msg) {
-	char msg_error[strlen(msg) + 128];
-	strncpy(msg_error, msg, sizeof(msg_error) - 1);
-	msg_error[sizeof(msg_error) - 1] = '\0';
-	// Use strncat to calculate left space in string
-	strncat(msg_error, " Details: ", sizeof(msg_error) - strlen(msg_error) - 1);
-	strncat(msg_error, strerror(errno), sizeof(msg_error) - strlen(msg_error) - 1);
-	fprintf(stderr, "%s\n", msg_error);
-	terminate_generators("Error handling");
+	long long now = monotonic_ns();
+	if (now >= *next_stats) {
+		print_stats(stderr, prog_name, shm);
+		*next_stats = now + interval * 1000000000LL;
+	}
 
-	exit(EXIT_FAILURE);
+	struct timespec deadline;
+	realtime_after(&deadline, *next_stats - now);
+	return sem_timedwait(used_sem, &deadline);
 }
 
 /**
- * @brief Send termination signals to all running generators.
+ * @brief Reads the solution of a used slot that was just acquired and frees the slot
  *
- * @param message (Optional, may be NULL) Message to be dispalayed during debug.
+ * @details The used semaphore is posted after the slot is published, but with several
+ *          generators the slot at the read position may still be in the middle of a write.
+ *
+ * @return false if the slot wasn't published within DRAIN_TIMEOUT_NS, its generator died
  */
-void terminate_generators(const char *message) {
-	debug("TERMINATION OF GENERATORS IS NOT SET UP YET!!!!");
-	exit(EXIT_FAILURE); // Remove after implementation
-	if (message != NULL)
-		debug("Termination of generators was requested, sending SIGTERMs signals...");
-	else
-		debug("Termination of generators was requested. Message: %s. Sending SIGTERMs...", \
-			message);
-	int pid;
-	kill(pid, SIGTERM);
+bool take_solution(Solution *solution) {
+	long long deadline = monotonic_ns() + DRAIN_TIMEOUT_NS;
+	while (!ring_consume(shm, solution)) {
+		if (monotonic_ns() > deadline) return false;
+		sched_yield();
+	}
+	if (sem_post(free_sem) == -1)
+		handle_error("Failed to release a slot.");
+	return true;
 }
 
 /**
- * @brief Create and size shared memory based on SHM_NAME and MAX_DATA in struct
+ * @brief Counts a solution and keeps it if it beats the best one
+ *
+ * @details An improvement is printed and saved to the checkpoint right away, so an
+ *          interrupted supervisor loses nothing.
  *
- * @return shared memory file descriptor
+ * @return true once the graph is known to be solved, by 0 edges or an optimal solution
  */
+bool record_solution(const Solution *solution) {
+	unsigned long consumed = atomic_fetch_add_explicit(&shm->supervisor_stats.consumed, 1, memory_order_relaxed);
+	TRACE_COUNTER(TRACE_INFO, "consumed", consumed + 1);
+
+	Solution *best = &progress.best;
+	if (solution->count < best->count || (solution->optimal && !best->optimal && solution->count == best->count)) {
+		*best = *solution;
+		TRACE(TRACE_INFO, "improved", best->count, best->optimal);
+		atomic_store(&shm->supervisor_stats.best, best->count);
+		atomic_store(&shm->supervisor_stats.improved_ns, monotonic_ns());
+		print_solution(best);
+		if (checkpoint_path != NULL) save_checkpoint(checkpoint_path);
+	}
+	return best->count == 0 || best->optimal;
+}
 
-int create_shared_memory(void) {
-	int shmfd = shm_open(SHM_NAME, O_RDWR | O_CREAT, 0600); // Owner permission
-	if (shmfd == -1)
-		handle_error("Failed to create shared memory.");
+/**
+ * @brief Reads the last solutions of the generators after termination
+ *
+ * @details Generators write their best dropped solution before they detach. Reading goes
+ *          on until none is attached anymore or DRAIN_TIMEOUT_NS passed, so neither a
+ *          generator stays blocked on a full buffer nor a stuck one holds the supervisor.
+ */
+void drain_generators(void) {
+	Solution solution;
+	long long deadline = monotonic_ns() + DRAIN_TIMEOUT_NS;
+	while (atomic_load(&shm->generators) > 0) {
+		long long left = deadline - monotonic_ns();
+		if (left <= 0) {
+			debug("%d generators didn't detach in time", atomic_load(&shm->generators));
+			break;
+		}
+		struct timespec until;
+		realtime_after(&until, left < DRAIN_SLICE_NS ? left : DRAIN_SLICE_NS);
+		if (sem_timedwait(used_sem, &until) == 0) {
+			if (!take_solution(&solution)) return;
+			record_solution(&solution);
+		} else if (errno != EINTR && errno != ETIMEDOUT) {
+			handle_error("Failed to wait for a solution.");
+		}
+	}
+	while (sem_trywait(used_sem) == 0 && take_solution(&solution))
+		record_solution(&solution);
+}
 
-	// Set size of shared memory
-	if (ftruncate(shmfd, sizeof(shm_t)) == -1)
-		handle_error("Failed to set size for shared memory.");
+/**
+ * @brief Resumes from a checkpoint file, a missing file starts a new run
+ *
+ * @details The file has one record per line: "epoch N", "best COUNT OPTIMAL", one
+ *          "edge U V" per edge of the best solution. Only the best solution is resumed,
+ *          generators that attach later start searching from scratch.
+ */
+void load_checkpoint(const char *path) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		if (errno == ENOENT) return;
+		handle_error("Failed to open checkpoint.");
+	}
+
+	char line[128];
+	unsigned long epoch = 0;
+	int count = MAX_SOLUTION_EDGES + 1, optimal = 0, edges = 0;
+	Edge edge;
+	bool valid = true;
+	while (valid && fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "epoch %lu", &epoch) == 1) continue;
+		if (sscanf(line, "best %d %d", &count, &optimal) == 2) continue;
+		if (sscanf(line, "edge %d %d", &edge.u, &edge.v) == 2) {
+			if (edges < MAX_SOLUTION_EDGES) progress.best.edges[edges] = edge;
+			edges++;
+			continue;
+		}
+		valid = false;
+	}
+	fclose(file);
+	if (!valid || count < 0 || (count <= MAX_SOLUTION_EDGES && edges != count)) {
+		fprintf(stderr, "[%s] Invalid checkpoint %s\n", prog_name, path);
+		exit(EXIT_FAILURE);
+	}
+
+	progress.epoch = epoch + 1;
+	if (count <= MAX_SOLUTION_EDGES) {
+		progress.best.count = count;
+		progress.best.optimal = optimal != 0;
+		fprintf(stderr, "[%s] Resuming run %lu from %s\n", prog_name, progress.epoch, path);
+		print_solution(&progress.best);
+	}
+}
 
-	return shmfd;
+/**
+ * @brief Saves the best solution to the checkpoint file
+ *
+ * @details Writes a temporary file next to it and renames it over the old one, so the
+ *          checkpoint is complete even if the supervisor dies while saving. Failures are
+ *          only reported, the search goes on without a checkpoint.
+ */
+void save_checkpoint(const char *path) {
+	char tmp[strlen(path) + 5];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *file = fopen(tmp, "w");
+	if (file == NULL) {
+		fprintf(stderr, "[%s] Failed to save checkpoint: %s\n", prog_name, strerror(errno));
+		return;
+	}
+
+	const Solution *best = &progress.best;
+	fprintf(file, "epoch %lu\n", progress.epoch);
+	if (best->count <= MAX_SOLUTION_EDGES) {
+		fprintf(file, "best %d %d\n", best->count, best->optimal);
+		for (int i = 0; i < best->count; i++)
+			fprintf(file, "edge %d %d\n", best->edges[i].u, best->edges[i].v);
+	}
+
+	bool saved = fflush(file) == 0 && fsync(fileno(file)) == 0;
+	saved = fclose(file) == 0 && saved;
+	if (!saved || rename(tmp, path) == -1) {
+		fprintf(stderr, "[%s] Failed to save checkpoint: %s\n", prog_name, strerror(errno));
+		unlink(tmp);
+	}
+}
+
+/**
+ * @brief Prints a new best solution to stderr
+ *
+ * @param solution Solution whose edges are printed as u-v pairs
+ */
+void print_solution(const Solution *solution) {
+	fprintf(stderr, "[%s] %s with %d edges:", prog_name, solution->optimal ? "Optimal solution" : "Solution",
+		solution->count);
+	for (int i = 0; i < solution->count; i++)
+		fprintf(stderr, " %d-%d", solution->edges[i].u, solution->edges[i].v);
+	fprintf(stderr, "\n");
 }
 
 /**
- * @brief Maps shared memory from file descriptor
+ * @brief Outputs message and current error description. Terminates execution of program.
  *
- * @return shm Starting address of the mapping
+ * @param msg Message to be displayed to stderr stream.
  */
 
-shm_t* map_shared_memory(int shmfd) {
-	shm_t *shm;
-	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+void handle_error(const char *msg) {
+	char msg_error[strlen(msg) + 128];
+	strncpy(msg_error, msg, sizeof(msg_error) - 1);
+	msg_error[sizeof(msg_error) - 1] = '\0';
+	// Use strncat to calculate left space in string
+	strncat(msg_error, " Details: ", sizeof(msg_error) - strlen(msg_error) - 1);
+	strncat(msg_error, strerror(errno), sizeof(msg_error) - strlen(msg_error) - 1);
+	fprintf(stderr, "%s\n", msg_error);
+	terminate_generators("Error handling");
+	release_resources();
 
-	if (shm == MAP_FAILED)
-		handle_error("Failed to map shared memory.");
+	exit(EXIT_FAILURE);
+}
 
-	if (close(shmfd) == -1)
-		handle_error("Failed to close shared memory file descriptor.");
+/**
+ * @brief Tells all running generators to terminate.
+ *
+ * @details Sets the terminate bit of the epoch word. Generators blocked on a full buffer
+ *          check it at least every WAIT_SLICE_NS, so no semaphore has to be posted.
+ *
+ * @param message (Optional, may be NULL) Message to be dispalayed during debug.
+ */
+void terminate_generators(const char *message) {
+	if (message == NULL)
+		debug("Termination of generators was requested");
+	else
+		debug("Termination of generators was requested. Message: %s", message);
+	if (shm == NULL)
+		return;
 
-	return shm;
+	atomic_fetch_or(&shm->epoch, EPOCH_TERMINATE);
 }
 
 /**
- * @brief Cleanup of shared memory. Unmapping and removing of object
+ * @brief Cleanup of shared memory and semaphores. Unmapping, closing and removing of objects
  *
- * @param shm Shared memory structure object
+ * @details Failures are only reported, the cleanup runs during error handling as well.
  */
-void release_shared_memory(shm_t *shm) {
-	if (munmap(shm, sizeof(*shm)) == -1)
-		handle_error("Failed to unmap shared memory");
-	if (shm_unlink(SHM_NAME) == -1)
-		handle_error("Failed to unlink shared memory");
+void release_resources(void) {
+	shm = NULL;
+	free_sem = used_sem = NULL;
+	if (ipc_channel_close(&channel) == -1)
+		fprintf(stderr, "Failed to remove shared memory or semaphores: %s\n", strerror(errno));
 }
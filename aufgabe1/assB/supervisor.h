@@ -1,5 +1,32 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
 #include "header.h"
 
+#define DRAIN_TIMEOUT_NS 1000000000LL /**< How long generators get to write their last solution */
+#define DRAIN_SLICE_NS 10000000LL /**< Interval in which the drain checks for detached generators */
+
+/**
+ * @brief What the supervisor keeps across runs in its checkpoint file
+ *
+ * @details epoch is the number of the run, it is shifted into the epoch word of the shared
+ *          memory. best.count is MAX_SOLUTION_EDGES + 1 while no solution was read.
+ */
 typedef struct {
-	int data[MAX_EDGES][MAX_EDGES];
-}
+	unsigned long epoch;
+	Solution best;
+} Checkpoint;
+
+void usage(void);
+void print_solution(const Solution *solution);
+int wait_for_solution(unsigned int interval, long long *next_stats);
+bool take_solution(Solution *solution);
+bool record_solution(const Solution *solution);
+void drain_generators(void);
+void load_checkpoint(const char *path);
+void save_checkpoint(const char *path);
+void handle_error(const char *msg);
+void terminate_generators(const char *message);
+void release_resources(void);
+
+#endif
@@ -0,0 +1,270 @@
+/**
+ * @file ipc.c
+ *
+ * @brief Shared memory segments, named semaphores and ring channels for all components
+ *
+ * @details Every object is named "/<namespace>.<object>", so the 3-coloring supervisor,
+ *          CircBuff and the Semaphores demos can run side by side without one unlinking
+ *          the objects of another. Segments can be prefaulted with MAP_POPULATE and locked
+ *          with mlock(), so the first writes on the hot path don't take page faults.
+ *          Teardown is the same for everything: close unmaps or closes and, in the
+ *          process that created the object, unlinks it. Closing an object that was never
+ *          opened or is already closed does nothing, so cleanup code may run at any time.
+ *          On NUMA machines a segment can be bound to a node and processes pinned to
+ *          its CPUs. Functions return 0 or -1 with errno set.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#define _GNU_SOURCE // cpu_set_t and sched_setaffinity()
+#include "ipc.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// From <numaif.h>, which only comes with libnuma
+#define MPOL_BIND 2
+#define MPOL_MF_MOVE (1 << 1)
+#define IPC_MAX_NODES 1024
+
+/**
+ * @brief Builds the name of object in namespace ns
+ *
+ * @return -1 with ENAMETOOLONG if it doesn't fit into IPC_NAME_LEN
+ */
+int ipc_name(char name[IPC_NAME_LEN], const char *ns, const char *object) {
+	int len = snprintf(name, IPC_NAME_LEN, "/%s.%s", ns, object);
+	if (len < 0 || len >= IPC_NAME_LEN) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return 0;
+}
+
+static int map_segment(IpcSegment *segment, int fd, int flags) {
+	int prot = flags & IPC_READONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+	int map_flags = MAP_SHARED | (fd == -1 ? MAP_ANONYMOUS : 0) | (flags & IPC_PREFAULT ? MAP_POPULATE : 0);
+	void *addr = mmap(NULL, segment->size, prot, map_flags, fd, 0);
+	if (addr == MAP_FAILED) return -1;
+	segment->addr = addr;
+
+	// RLIMIT_MEMLOCK is small for unprivileged users, an unlocked segment still works
+	if (flags & IPC_LOCK) {
+		segment->locked = mlock(addr, segment->size) == 0;
+		if (!segment->locked) debug("Couldn't lock %s: %s", segment->name, strerror(errno));
+	}
+	return 0;
+}
+
+static void segment_reset(IpcSegment *segment, size_t size) {
+	memset(segment, 0, sizeof(*segment));
+	segment->size = size;
+}
+
+/**
+ * @brief Creates and maps a segment of size bytes, filled with zeros
+ *
+ * @details Fails with EEXIST if the name is taken, a second instance mustn't take over
+ *          the objects of a running one.
+ *
+ * @param object Name within the namespace, NULL for an anonymous segment
+ */
+int ipc_segment_create(IpcSegment *segment, const char *ns, const char *object, size_t size, int flags) {
+	segment_reset(segment, size);
+	if (object == NULL) return map_segment(segment, -1, flags & ~IPC_READONLY);
+
+	if (ipc_name(segment->name, ns, object) == -1) return -1;
+	debug("Creating segment %s of %zu bytes", segment->name, size);
+	int fd = shm_open(segment->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) return -1;
+	segment->owner = true;
+
+	int res = ftruncate(fd, size);
+	if (res == 0) res = map_segment(segment, fd, flags & ~IPC_READONLY);
+	int saved = errno;
+	close(fd);
+	if (res == -1) {
+		shm_unlink(segment->name);
+		segment->owner = false;
+		errno = saved;
+	}
+	return res;
+}
+
+/**
+ * @brief Maps a segment another process created, which has to be at least size bytes
+ */
+int ipc_segment_open(IpcSegment *segment, const char *ns, const char *object, size_t size, int flags) {
+	segment_reset(segment, size);
+	if (ipc_name(segment->name, ns, object) == -1) return -1;
+	int fd = shm_open(segment->name, flags & IPC_READONLY ? O_RDONLY : O_RDWR, 0);
+	if (fd == -1) return -1;
+
+	struct stat st;
+	int res = fstat(fd, &st);
+	if (res == 0 && (size_t) st.st_size < size) {
+		errno = EINVAL; // created by an incompatible build
+		res = -1;
+	}
+	if (res == 0) res = map_segment(segment, fd, flags);
+	int saved = errno;
+	close(fd);
+	errno = saved;
+	return res;
+}
+
+/**
+ * @brief true as long as the name of the segment wasn't unlinked
+ *
+ * @details The mapping outlives an unlink, this tells a reader that its creator is gone.
+ */
+bool ipc_segment_exists(const IpcSegment *segment) {
+	int fd = shm_open(segment->name, O_RDONLY, 0);
+	if (fd == -1) return false;
+	close(fd);
+	return true;
+}
+
+int ipc_segment_close(IpcSegment *segment) {
+	int res = 0;
+	if (segment->addr != NULL) {
+		if (segment->locked) munlock(segment->addr, segment->size);
+		if (munmap(segment->addr, segment->size) == -1) res = -1;
+	}
+	if (segment->owner && shm_unlink(segment->name) == -1) res = -1;
+	memset(segment, 0, sizeof(*segment));
+	return res;
+}
+
+/**
+ * @brief Creates a semaphore with value, fails with EEXIST if the name is taken
+ */
+int ipc_sem_create(IpcSemaphore *sem, const char *ns, const char *object, unsigned int value) {
+	memset(sem, 0, sizeof(*sem));
+	if (ipc_name(sem->name, ns, object) == -1) return -1;
+	debug("Creating semaphore %s with value %u", sem->name, value);
+	sem_t *handle = sem_open(sem->name, O_CREAT | O_EXCL, 0600, value);
+	if (handle == SEM_FAILED) return -1;
+	sem->sem = handle;
+	sem->owner = true;
+	return 0;
+}
+
+int ipc_sem_open(IpcSemaphore *sem, const char *ns, const char *object) {
+	memset(sem, 0, sizeof(*sem));
+	if (ipc_name(sem->name, ns, object) == -1) return -1;
+	sem_t *handle = sem_open(sem->name, 0);
+	if (handle == SEM_FAILED) return -1;
+	sem->sem = handle;
+	return 0;
+}
+
+int ipc_sem_close(IpcSemaphore *sem) {
+	int res = 0;
+	if (sem->sem != NULL && sem_close(sem->sem) == -1) res = -1;
+	if (sem->owner && sem_unlink(sem->name) == -1) res = -1;
+	memset(sem, 0, sizeof(*sem));
+	return res;
+}
+
+/**
+ * @brief Creates the segment "<ns>.shm" and the semaphores "<ns>.free" with slots and
+ *        "<ns>.used" with 0, everything created so far is removed again on failure
+ */
+int ipc_channel_create(IpcChannel *channel, const char *ns, size_t size, unsigned int slots, int flags) {
+	memset(channel, 0, sizeof(*channel));
+	if (ipc_segment_create(&channel->segment, ns, "shm", size, flags) == 0
+			&& ipc_sem_create(&channel->free, ns, "free", slots) == 0
+			&& ipc_sem_create(&channel->used, ns, "used", 0) == 0)
+		return 0;
+
+	int saved = errno;
+	ipc_channel_close(channel);
+	errno = saved;
+	return -1;
+}
+
+int ipc_channel_open(IpcChannel *channel, const char *ns, size_t size, int flags) {
+	memset(channel, 0, sizeof(*channel));
+	if (ipc_segment_open(&channel->segment, ns, "shm", size, flags) == 0
+			&& ipc_sem_open(&channel->free, ns, "free") == 0
+			&& ipc_sem_open(&channel->used, ns, "used") == 0)
+		return 0;
+
+	int saved = errno;
+	ipc_channel_close(channel);
+	errno = saved;
+	return -1;
+}
+
+/**
+ * @brief Closes all three objects, even if closing one of them failed
+ */
+int ipc_channel_close(IpcChannel *channel) {
+	int res = 0;
+	if (ipc_segment_close(&channel->segment) == -1) res = -1;
+	if (ipc_sem_close(&channel->free) == -1) res = -1;
+	if (ipc_sem_close(&channel->used) == -1) res = -1;
+	return res;
+}
+
+/**
+ * @brief Binds the pages of a segment to a NUMA node, pages already faulted in move there
+ *
+ * @details The policy belongs to the shared memory object, pages other processes fault
+ *          in later come from node as well. The mbind system call is used directly.
+ */
+int ipc_segment_bind(const IpcSegment *segment, int node) {
+	unsigned long mask[IPC_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+	if (node < 0 || node >= IPC_MAX_NODES) {
+		errno = EINVAL;
+		return -1;
+	}
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+	debug("Binding %s to node %d", segment->name, node);
+	return syscall(SYS_mbind, segment->addr, segment->size, MPOL_BIND, mask, IPC_MAX_NODES + 1, MPOL_MF_MOVE);
+}
+
+/**
+ * @brief Restricts the calling thread, and threads it creates afterwards, to the CPUs of a node
+ *
+ * @return -1 with ENOENT if there is no such node, EINVAL if it has no CPUs
+ */
+int ipc_pin_to_node(int node) {
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	FILE *list = fopen(path, "r");
+	if (list == NULL) return -1;
+
+	// The list looks like "0-3,8-11"
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	int first, last, count = 0;
+	while (fscanf(list, "%d", &first) == 1) {
+		last = first;
+		int next = fgetc(list);
+		if (next == '-') {
+			if (fscanf(list, "%d", &last) != 1) break;
+			next = fgetc(list);
+		}
+		for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++, count++)
+			CPU_SET(cpu, &cpus);
+		if (next != ',') break;
+	}
+	fclose(list);
+
+	if (count == 0) {
+		errno = EINVAL; // a node with memory only
+		return -1;
+	}
+	debug("Pinning to the %d CPUs of node %d", count, node);
+	return sched_setaffinity(0, sizeof(cpus), &cpus);
+}
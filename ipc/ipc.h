@@ -0,0 +1,62 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <semaphore.h>
+
+#define IPC_NAME_LEN 64
+
+// Flags of ipc_segment_create() and ipc_segment_open()
+#define IPC_READONLY 0x1 // map without write access, only for opening
+#define IPC_PREFAULT 0x2 // fault every page in while mapping, MAP_POPULATE
+#define IPC_LOCK     0x4 // keep the pages resident with mlock(), best effort
+
+/* Shared memory object "/<namespace>.<object>" and its mapping. The process that
+   created it owns the name and unlinks it on ipc_segment_close(). An anonymous
+   segment has an empty name and is only shared with children forked afterwards */
+typedef struct {
+	char name[IPC_NAME_LEN];
+	void *addr;
+	size_t size;
+	bool owner;
+	bool locked;
+} IpcSegment;
+
+/* Named POSIX semaphore "/<namespace>.<object>", unlinked by its creator on close */
+typedef struct {
+	char name[IPC_NAME_LEN];
+	sem_t *sem;
+	bool owner;
+} IpcSemaphore;
+
+/* A segment with a bounded buffer in it plus the semaphores counting its free and
+   used slots. The channel doesn't care how the buffer is laid out, IPC_CHANNEL_DATA
+   gives the segment as the record type of the component */
+typedef struct {
+	IpcSegment segment;
+	IpcSemaphore free;
+	IpcSemaphore used;
+} IpcChannel;
+
+#define IPC_CHANNEL_DATA(channel, type) ((type *) (channel)->segment.addr)
+
+int ipc_name(char name[IPC_NAME_LEN], const char *ns, const char *object);
+
+int ipc_segment_create(IpcSegment *segment, const char *ns, const char *object, size_t size, int flags);
+int ipc_segment_open(IpcSegment *segment, const char *ns, const char *object, size_t size, int flags);
+bool ipc_segment_exists(const IpcSegment *segment);
+int ipc_segment_close(IpcSegment *segment);
+
+int ipc_segment_bind(const IpcSegment *segment, int node);
+int ipc_pin_to_node(int node);
+
+int ipc_sem_create(IpcSemaphore *sem, const char *ns, const char *object, unsigned int value);
+int ipc_sem_open(IpcSemaphore *sem, const char *ns, const char *object);
+int ipc_sem_close(IpcSemaphore *sem);
+
+int ipc_channel_create(IpcChannel *channel, const char *ns, size_t size, unsigned int slots, int flags);
+int ipc_channel_open(IpcChannel *channel, const char *ns, size_t size, int flags);
+int ipc_channel_close(IpcChannel *channel);
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file trace.c
+ *
+ * @brief Records binary trace events per thread and dumps them as Chrome trace JSON
+ *
+ * @details Every thread writes its events into a ring of its own that it allocates on its
+ *          first event, so recording takes no lock and no system call besides the clock.
+ *          Formatting happens only once, at exit, when all rings are written to a JSON
+ *          file that chrome://tracing and Perfetto open. Tracing is set up from the
+ *          environment before main:
+ *          TRACE_LEVEL  off, error, info, debug or 0-3, nothing is recorded without it
+ *          TRACE_FILE   file to dump to, trace.<pid>.json by default. A forked child that
+ *                       exits normally dumps its own events to the name with .<pid> added.
+ *
+ * @author Volodymyr Skoryi
+ * @date 08.11.2024
+ */
+
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+/* head counts the events ever written, only the owning thread writes. The dump reads
+   the last TRACE_RING_EVENTS of them */
+typedef struct TraceRing {
+	struct TraceRing *next;
+	long tid;
+	atomic_ulong head;
+	TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+int trace_level = TRACE_OFF;
+
+static _Atomic(TraceRing *) rings = NULL;
+static _Thread_local TraceRing *ring = NULL;
+static const char *dump_path = NULL;
+static pid_t setup_pid = 0;
+
+static TraceRing *register_ring(void) {
+	TraceRing *new_ring = malloc(sizeof(TraceRing));
+	if (new_ring == NULL) return NULL;
+	new_ring->tid = syscall(SYS_gettid);
+	atomic_init(&new_ring->head, 0);
+	new_ring->next = atomic_load(&rings);
+	while (!atomic_compare_exchange_weak(&rings, &new_ring->next, new_ring));
+	return new_ring;
+}
+
+/**
+ * @brief Appends an event to the ring of the calling thread, use the TRACE macros instead
+ */
+void trace_record(int level, char phase, const char *name, int64_t a, int64_t b) {
+	if (ring == NULL && (ring = register_ring()) == NULL) return;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	TraceEvent *event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+	event->ts_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+	event->name = name;
+	event->a = a;
+	event->b = b;
+	event->phase = phase;
+	event->level = level;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void write_string(FILE *out, const char *str) {
+	fputc('"', out);
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\') fputc('\\', out);
+		if ((unsigned char) *str >= 0x20) fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+/**
+ * @brief Writes the events of all threads to path as Chrome trace JSON
+ *
+ * @details Meant for the end of a run, events a thread writes meanwhile may come out torn.
+ *
+ * @return 0 or -1 with errno set
+ */
+int trace_dump(const char *path) {
+	FILE *out = fopen(path, "w");
+	if (out == NULL) return -1;
+
+	int pid = getpid();
+	bool first = true;
+	fprintf(out, "{\"traceEvents\":[");
+	for (TraceRing *r = atomic_load(&rings); r != NULL; r = r->next) {
+		unsigned long head = atomic_load_explicit(&r->head, memory_order_acquire);
+		unsigned long start = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+		for (unsigned long i = start; i < head; i++) {
+			const TraceEvent *event = &r->events[i & (TRACE_RING_EVENTS - 1)];
+			fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+			write_string(out, event->name);
+			fprintf(out, ",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%ld", event->phase,
+				(long long) (event->ts_ns / 1000), (long long) (event->ts_ns % 1000), pid, r->tid);
+			if (event->phase == 'i')
+				fprintf(out, ",\"s\":\"t\",\"args\":{\"a\":%lld,\"b\":%lld}", (long long) event->a,
+					(long long) event->b);
+			else if (event->phase == 'C')
+				fprintf(out, ",\"args\":{\"value\":%lld}", (long long) event->a);
+			fputc('}', out);
+			first = false;
+		}
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+	return fclose(out) == EOF ? -1 : 0;
+}
+
+static void dump_at_exit(void) {
+	char path[4096];
+	if (dump_path != NULL && getpid() == setup_pid)
+		snprintf(path, sizeof(path), "%s", dump_path);
+	else if (dump_path != NULL)
+		snprintf(path, sizeof(path), "%s.%d", dump_path, (int) getpid());
+	else
+		snprintf(path, sizeof(path), "trace.%d.json", (int) getpid());
+	if (trace_dump(path) == -1)
+		fprintf(stderr, "[trace] Failed to write %s\n", path);
+}
+
+// A forked child starts without the events of its parent
+static void forget_rings(void) {
+	atomic_store(&rings, NULL);
+	ring = NULL;
+}
+
+static int parse_level(const char *str) {
+	const char *names[] = {"off", "error", "info", "debug"};
+	for (int level = TRACE_OFF; level <= TRACE_DEBUG; level++) {
+		if (strcasecmp(str, names[level]) == 0) return level;
+	}
+	int level = atoi(str);
+	return level < TRACE_OFF ? TRACE_OFF : level > TRACE_DEBUG ? TRACE_DEBUG : level;
+}
+
+__attribute__((constructor)) static void trace_setup(void) {
+	const char *level = getenv("TRACE_LEVEL");
+	if (level == NULL || (trace_level = parse_level(level)) == TRACE_OFF) return;
+	if (trace_level > TRACE_COMPILE_LEVEL)
+		fprintf(stderr, "[trace] TRACE_LEVEL %d is above the compiled in level %d\n", trace_level,
+			TRACE_COMPILE_LEVEL);
+
+	dump_path = getenv("TRACE_FILE");
+	setup_pid = getpid();
+	pthread_atfork(NULL, NULL, forget_rings);
+	atexit(dump_at_exit);
+}
@@ -0,0 +1,78 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_OFF 0
+#define TRACE_ERROR 1
+#define TRACE_INFO 2
+#define TRACE_DEBUG 3
+
+/**
+ * @def TRACE_COMPILE_LEVEL
+ * @brief Events above this level are not compiled in at all
+ * @details Defaults to TRACE_DEBUG with -DDEBUG and to TRACE_INFO otherwise, -DTRACE_COMPILE_LEVEL=0
+ *          removes every event. Below it the environment variable TRACE_LEVEL (off, error, info,
+ *          debug or 0-3) decides at runtime, nothing is recorded unless it is set.
+ */
+#ifndef TRACE_COMPILE_LEVEL
+	#ifdef DEBUG
+		#define TRACE_COMPILE_LEVEL TRACE_DEBUG
+	#else
+		#define TRACE_COMPILE_LEVEL TRACE_INFO
+	#endif
+#endif
+
+#define TRACE_RING_EVENTS 65536 // per thread, must stay a power of two, the oldest events are overwritten
+
+/**
+ * @def debug
+ * @brief Prints developer messages in DEBUG builds only
+ * @details When a file is compiled with a -DDEBUG flag, 'debug' macro is going to print
+ *          debug information to stderr stream including file name and line number. In case
+ *          this flag was not specified, than debug outputs are not going to be printed.
+ *          It is not part of tracing: the messages are formatted and written right away
+ *          and never show up in the trace dump. Anything worth seeing in a profile of a
+ *          release build is recorded with the TRACE macros instead.
+ * @param fmt The format string, similar to printf
+ * @param ... Additional arguments to plug in the string
+ */
+#ifdef DEBUG
+	#define debug(fmt, ...) \
+		(void) fprintf(stderr, "[%s:%d] " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+	#define debug(msg, ...)
+#endif
+
+/* One recorded event. name has to be a string literal or live until the dump, the
+   event only keeps the pointer. phase is the Chrome trace phase: 'i' instant,
+   'B'/'E' begin/end of a span on the thread, 'C' counter with value a */
+typedef struct {
+	int64_t ts_ns; // CLOCK_MONOTONIC
+	const char *name;
+	int64_t a;
+	int64_t b;
+	char phase;
+	uint8_t level;
+} TraceEvent;
+
+extern int trace_level; // runtime level, set from TRACE_LEVEL before main
+
+void trace_record(int level, char phase, const char *name, int64_t a, int64_t b);
+int trace_dump(const char *path);
+
+#define trace_enabled(level) ((level) <= TRACE_COMPILE_LEVEL && (level) <= trace_level)
+
+// Instant event with two numbers
+#define TRACE(level, name, a, b) \
+	do { if (trace_enabled(level)) trace_record(level, 'i', name, a, b); } while (0)
+// Span of work on the calling thread, every TRACE_BEGIN needs its TRACE_END
+#define TRACE_BEGIN(level, name) \
+	do { if (trace_enabled(level)) trace_record(level, 'B', name, 0, 0); } while (0)
+#define TRACE_END(level, name) \
+	do { if (trace_enabled(level)) trace_record(level, 'E', name, 0, 0); } while (0)
+#define TRACE_COUNTER(level, name, value) \
+	do { if (trace_enabled(level)) trace_record(level, 'C', name, value, 0); } while (0)
+
+#endif